@@ -0,0 +1,371 @@
+/* microbenchmarks for the primitives on libgroove's hot paths, reported as
+ * JSON. links against the static library to reach internal functions. */
+
+#include "src/queue.h"
+#include "src/buffer.h"
+#include "src/area.h"
+#include "src/util.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_THREADS 64
+#define GET_MANY_COUNT 64
+#define PERIOD_FRAMES 512
+
+static FILE *out;
+static bool first_result = true;
+static const char *filter;
+
+// queued objects only need to be distinct from the NULL end sentinel
+static int dummy_obj;
+
+static int usage(char *arg0) {
+    fprintf(stderr, "Usage: %s [--ops 1000000] [--threads N] [--filter name]\n"
+            "    [--output results.json]\n"
+            "\n"
+            "Measures queue put/get under contention, buffer ref/unref fan-out,\n"
+            "queue purge and the audio callback copy loops. --filter runs only the\n"
+            "benchmarks whose name contains the given string.\n", arg0);
+    return 1;
+}
+
+static double wall_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static bool selected(const char *name) {
+    return !filter || strstr(name, filter);
+}
+
+static void report(const char *name, int threads, long ops, double seconds) {
+    fprintf(stderr, "%s x%d: %.1f ns/op\n", name, threads, seconds * 1e9 / ops);
+    fprintf(out, "%s\n    {\"name\": \"%s\", \"threads\": %d, \"ops\": %ld, \"seconds\": %.6f, "
+            "\"ns_per_op\": %.3f, \"ops_per_second\": %.0f}", first_result ? "" : ",",
+            name, threads, ops, seconds, seconds * 1e9 / ops, ops / seconds);
+    first_result = false;
+}
+
+static void cleanup_nothing(struct GrooveQueue *queue, void *obj) {
+}
+
+static struct GrooveQueue *create_queue(void) {
+    struct GrooveQueue *queue = groove_queue_create();
+    if (!queue)
+        groove_panic("out of memory");
+    queue->cleanup = cleanup_nothing;
+    return queue;
+}
+
+static void bench_queue_put_get(long ops) {
+    struct GrooveQueue *queue = create_queue();
+    void *obj;
+    double start = wall_now();
+    for (long i = 0; i < ops; i += 1) {
+        groove_queue_put(queue, &dummy_obj);
+        groove_queue_get(queue, &obj, 0);
+    }
+    report("queue_put_get", 1, ops, wall_now() - start);
+    groove_queue_destroy(queue);
+}
+
+struct Consumer {
+    pthread_t thread;
+    struct GrooveQueue *queue;
+    bool get_many;
+};
+
+// takes objects until it gets the NULL end sentinel
+static void *consumer_thread(void *arg) {
+    struct Consumer *consumer = (struct Consumer *)arg;
+    if (consumer->get_many) {
+        void *objs[GET_MANY_COUNT];
+        for (;;) {
+            int count = groove_queue_get_many(consumer->queue, objs, GET_MANY_COUNT, 1);
+            if (count <= 0 || !objs[count - 1])
+                break;
+        }
+    } else {
+        void *obj;
+        while (groove_queue_get(consumer->queue, &obj, 1) == 1 && obj) {}
+    }
+    return NULL;
+}
+
+// one producer and consumer_count consumers sharing one queue
+static void bench_queue_contended(const char *name, long ops, int consumer_count, bool get_many) {
+    struct GrooveQueue *queue = create_queue();
+    struct Consumer consumers[MAX_THREADS];
+    for (int i = 0; i < consumer_count; i += 1) {
+        consumers[i].queue = queue;
+        consumers[i].get_many = get_many;
+        if (pthread_create(&consumers[i].thread, NULL, consumer_thread, &consumers[i]))
+            groove_panic("unable to create thread");
+    }
+
+    // the consumers are blocked on the empty queue until the first put
+    double start = wall_now();
+    for (long i = 0; i < ops; i += 1)
+        groove_queue_put(queue, &dummy_obj);
+    for (int i = 0; i < consumer_count; i += 1)
+        groove_queue_put(queue, NULL);
+    for (int i = 0; i < consumer_count; i += 1)
+        pthread_join(consumers[i].thread, NULL);
+    report(name, consumer_count, ops, wall_now() - start);
+
+    groove_queue_destroy(queue);
+}
+
+static struct GrooveBuffer *create_buffer(void) {
+    struct GrooveBufferPrivate *b = ALLOCATE(struct GrooveBufferPrivate, 1);
+    if (!b || pthread_mutex_init(&b->mutex, NULL))
+        groove_panic("out of memory");
+    b->ref_count = 1;
+    return &b->externals;
+}
+
+static void bench_buffer_ref_unref(long ops) {
+    struct GrooveBuffer *buffer = create_buffer();
+    double start = wall_now();
+    for (long i = 0; i < ops; i += 1) {
+        groove_buffer_ref(buffer);
+        groove_buffer_unref(buffer);
+    }
+    report("buffer_ref_unref", 1, ops, wall_now() - start);
+    groove_buffer_unref(buffer);
+}
+
+static void *buffer_consumer_thread(void *arg) {
+    struct Consumer *consumer = (struct Consumer *)arg;
+    void *obj;
+    while (groove_queue_get(consumer->queue, &obj, 1) == 1 && obj)
+        groove_buffer_unref((struct GrooveBuffer *)obj);
+    return NULL;
+}
+
+// the decode thread's delivery pattern: each new buffer is referenced once
+// per sink and put into every sink's queue, and each sink's consumer drops
+// its reference on its own thread
+static void bench_buffer_fanout(long ops, int sink_count) {
+    struct Consumer consumers[MAX_THREADS];
+    for (int i = 0; i < sink_count; i += 1) {
+        consumers[i].queue = create_queue();
+        if (pthread_create(&consumers[i].thread, NULL, buffer_consumer_thread, &consumers[i]))
+            groove_panic("unable to create thread");
+    }
+
+    double start = wall_now();
+    for (long i = 0; i < ops; i += 1) {
+        struct GrooveBuffer *buffer = create_buffer();
+        for (int s = 0; s < sink_count; s += 1) {
+            groove_buffer_ref(buffer);
+            groove_queue_put(consumers[s].queue, buffer);
+        }
+        groove_buffer_unref(buffer);
+    }
+    for (int i = 0; i < sink_count; i += 1)
+        groove_queue_put(consumers[i].queue, NULL);
+    for (int i = 0; i < sink_count; i += 1)
+        pthread_join(consumers[i].thread, NULL);
+    report("buffer_fanout", sink_count, ops, wall_now() - start);
+
+    for (int i = 0; i < sink_count; i += 1)
+        groove_queue_destroy(consumers[i].queue);
+}
+
+struct GroupedObj {
+    void *group;
+};
+
+static void *grouped_obj_group(struct GrooveQueue *queue, void *obj) {
+    return ((struct GroupedObj *)obj)->group;
+}
+
+// fills a queue with item_count objects spread over group_count groups and
+// times purging one group from the middle. if interleaved is false each group
+// is one contiguous run, as with playlist items; otherwise neighbouring
+// objects belong to different groups.
+static void bench_queue_purge(const char *name, int item_count, int group_count, bool interleaved,
+        int repeat)
+{
+    struct GroupedObj *objs = ALLOCATE(struct GroupedObj, item_count);
+    int *groups = ALLOCATE(int, group_count);
+    if (!objs || !groups)
+        groove_panic("out of memory");
+    int run_length = groove_max_int(item_count / group_count, 1);
+    for (int i = 0; i < item_count; i += 1) {
+        int group = interleaved ? (i % group_count) : groove_min_int(i / run_length, group_count - 1);
+        objs[i].group = &groups[group];
+    }
+
+    struct GrooveQueue *queue = create_queue();
+    queue->group = grouped_obj_group;
+    double seconds = 0.0;
+    for (int r = 0; r < repeat; r += 1) {
+        for (int i = 0; i < item_count; i += 1)
+            groove_queue_put(queue, &objs[i]);
+        double start = wall_now();
+        groove_queue_purge(queue, &groups[group_count / 2]);
+        seconds += wall_now() - start;
+        groove_queue_flush(queue);
+    }
+    report(name, 1, repeat, seconds);
+
+    groove_queue_destroy(queue);
+    DEALLOCATE(groups);
+    DEALLOCATE(objs);
+}
+
+struct CopyFormat {
+    const char *name;
+    int channel_count;
+    int bytes_per_sample;
+};
+
+static const struct CopyFormat copy_formats[] = {
+    {"s16_stereo", 2, 2},
+    {"float_stereo", 2, 4},
+    {"float_5.1", 6, 4},
+};
+
+// audio_callback's copy loops writing into a device buffer. most backends
+// hand out an interleaved buffer; names ending in _planar_device write into
+// one contiguous area per channel instead. one op is one frame.
+static void bench_area_copy(long ops, const struct CopyFormat *format, bool planar_device) {
+    int channel_count = format->channel_count;
+    int bytes_per_sample = format->bytes_per_sample;
+    int bytes_per_frame = channel_count * bytes_per_sample;
+    int period_bytes = PERIOD_FRAMES * bytes_per_frame;
+
+    uint8_t *device = ALLOCATE(uint8_t, period_bytes);
+    uint8_t *interleaved = ALLOCATE(uint8_t, period_bytes);
+    uint8_t *planes[SOUNDIO_MAX_CHANNELS];
+    if (!device || !interleaved)
+        groove_panic("out of memory");
+    for (int ch = 0; ch < channel_count; ch += 1) {
+        planes[ch] = ALLOCATE(uint8_t, PERIOD_FRAMES * bytes_per_sample);
+        if (!planes[ch])
+            groove_panic("out of memory");
+    }
+
+    struct SoundIoChannelArea areas[SOUNDIO_MAX_CHANNELS];
+    long periods = groove_max_long(ops / PERIOD_FRAMES, 1);
+    long frames = periods * PERIOD_FRAMES;
+    char name[64];
+
+    static const char *kind_names[] = {"interleaved", "planar", "silence"};
+    for (int kind = 0; kind < 3; kind += 1) {
+        snprintf(name, sizeof(name), "area_%s_%s%s", kind_names[kind], format->name,
+                planar_device ? "_planar_device" : "");
+        if (!selected(name))
+            continue;
+        double start = wall_now();
+        for (long i = 0; i < periods; i += 1) {
+            for (int ch = 0; ch < channel_count; ch += 1) {
+                if (planar_device) {
+                    areas[ch].ptr = (char *)device + ch * PERIOD_FRAMES * bytes_per_sample;
+                    areas[ch].step = bytes_per_sample;
+                } else {
+                    areas[ch].ptr = (char *)device + ch * bytes_per_sample;
+                    areas[ch].step = bytes_per_frame;
+                }
+            }
+            if (kind == 0) {
+                groove_area_copy_interleaved(areas, channel_count, bytes_per_sample,
+                        interleaved, PERIOD_FRAMES);
+            } else if (kind == 1) {
+                groove_area_copy_planar(areas, channel_count, bytes_per_sample,
+                        planes, 0, PERIOD_FRAMES);
+            } else {
+                groove_area_write_silence(areas, channel_count, bytes_per_sample,
+                        PERIOD_FRAMES);
+            }
+        }
+        report(name, 1, frames, wall_now() - start);
+    }
+
+    for (int ch = 0; ch < channel_count; ch += 1)
+        DEALLOCATE(planes[ch]);
+    DEALLOCATE(interleaved);
+    DEALLOCATE(device);
+}
+
+int main(int argc, char * argv[]) {
+    long ops = 1000000;
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_threads = (cpu_count > 0) ? (int)cpu_count : 4;
+    const char *output_file_name = NULL;
+
+    for (int i = 1; i < argc; i += 1) {
+        char *arg = argv[i];
+        if (arg[0] == '-' && arg[1] == '-') {
+            arg += 2;
+            if (i + 1 >= argc) {
+                return usage(argv[0]);
+            } else if (strcmp(arg, "ops") == 0) {
+                ops = atol(argv[++i]);
+            } else if (strcmp(arg, "threads") == 0) {
+                max_threads = atoi(argv[++i]);
+            } else if (strcmp(arg, "filter") == 0) {
+                filter = argv[++i];
+            } else if (strcmp(arg, "output") == 0) {
+                output_file_name = argv[++i];
+            } else {
+                return usage(argv[0]);
+            }
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (ops < 1 || max_threads < 1)
+        return usage(argv[0]);
+    max_threads = groove_min_int(max_threads, MAX_THREADS);
+
+    out = stdout;
+    if (output_file_name) {
+        out = fopen(output_file_name, "w");
+        if (!out) {
+            fprintf(stderr, "Error opening output file %s\n", output_file_name);
+            return 1;
+        }
+    }
+
+    fprintf(out, "{\n  \"results\": [");
+
+    if (selected("queue_put_get"))
+        bench_queue_put_get(ops);
+
+    // 1, 2, 4, ... threads, finishing with max_threads
+    for (int n = 1;; n = groove_min_int(n * 2, max_threads)) {
+        if (selected("queue_contended"))
+            bench_queue_contended("queue_contended", ops, n, false);
+        if (selected("queue_contended_get_many"))
+            bench_queue_contended("queue_contended_get_many", ops, n, true);
+        if (selected("buffer_fanout"))
+            bench_buffer_fanout(ops / 4, n);
+        if (n == max_threads)
+            break;
+    }
+
+    if (selected("buffer_ref_unref"))
+        bench_buffer_ref_unref(ops);
+
+    if (selected("queue_purge_runs"))
+        bench_queue_purge("queue_purge_runs", 100000, 100, false, 50);
+    if (selected("queue_purge_interleaved"))
+        bench_queue_purge("queue_purge_interleaved", 100000, 100, true, 50);
+
+    for (int i = 0; i < (int)ARRAY_LENGTH(copy_formats); i += 1) {
+        bench_area_copy(ops * 8, &copy_formats[i], false);
+        bench_area_copy(ops * 8, &copy_formats[i], true);
+    }
+
+    fprintf(out, "\n  ]\n}\n");
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
@@ -0,0 +1,676 @@
+/* end-to-end throughput benchmarks on synthetic audio, reported as JSON */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <groove/groove.h>
+#include <groove/encoder.h>
+#include <groove/loudness.h>
+#include <groove/waveform.h>
+#include <groove/fingerprinter.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_STREAMS 64
+#define PI 3.14159265358979323846
+
+struct Source {
+    int sample_rate;
+    int channel_count;
+};
+
+// every source is rendered to WAV and then encoded into each of these
+struct Codec {
+    const char *ext;
+    const char *format_short_name;
+    const char *codec_short_name;
+};
+
+static const struct Source sources[] = {
+    {44100, 2},
+    {48000, 2},
+    {96000, 2},
+    {22050, 1},
+};
+
+static const struct Codec codecs[] = {
+    {"wav", NULL, NULL},
+    {"flac", "flac", NULL},
+    {"mp3", "mp3", NULL},
+    {"ogg", "ogg", "libvorbis"},
+};
+
+#define SOURCE_COUNT ((int)(sizeof(sources) / sizeof(sources[0])))
+#define CODEC_COUNT ((int)(sizeof(codecs) / sizeof(codecs[0])))
+
+struct Input {
+    char path[512];
+    const char *name;
+    bool ok;
+};
+
+struct Measurement {
+    double audio_seconds;
+    double wall_seconds;
+    double cpu_seconds;
+};
+
+typedef int (*BenchFn)(struct Groove *groove, const char *path, int stream_count,
+        struct Measurement *m);
+
+static FILE *out;
+static bool first_result = true;
+
+static int usage(char *arg0) {
+    fprintf(stderr, "Usage: %s [--seconds 30] [--runs 3] [--streams N] [--filter name]\n"
+            "    [--output results.json] [--dir path] [--keep]\n"
+            "\n"
+            "Renders synthetic inputs into a temporary directory, then measures\n"
+            "decode, resample, transcode, loudness, waveform, fingerprint and\n"
+            "concurrent playlist throughput. --filter runs only the benchmarks\n"
+            "whose name contains the given string.\n", arg0);
+    return 1;
+}
+
+static double wall_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static double cpu_now(void) {
+    return clock() / (double)CLOCKS_PER_SEC;
+}
+
+static void write_u16(uint8_t *buf, uint16_t x) {
+    buf[0] = x & 0xff;
+    buf[1] = x >> 8;
+}
+
+static void write_u32(uint8_t *buf, uint32_t x) {
+    write_u16(buf, x & 0xffff);
+    write_u16(buf + 2, x >> 16);
+}
+
+// a different tone in each channel, slowly swelling, with some noise on top
+// so that the encoders and analyzers have real work to do
+static int render_source_wav(const char *path, const struct Source *source, double seconds) {
+    FILE *f = fopen(path, "wb");
+    if (!f)
+        return -1;
+
+    int channel_count = source->channel_count;
+    long frame_count = (long)(source->sample_rate * seconds);
+    uint32_t data_size = (uint32_t)(frame_count * channel_count * 2);
+
+    uint8_t header[44];
+    memcpy(header, "RIFF", 4);
+    write_u32(header + 4, 36 + data_size);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    write_u32(header + 16, 16);
+    write_u16(header + 20, 1); // PCM
+    write_u16(header + 22, channel_count);
+    write_u32(header + 24, source->sample_rate);
+    write_u32(header + 28, source->sample_rate * channel_count * 2);
+    write_u16(header + 32, channel_count * 2);
+    write_u16(header + 34, 16);
+    memcpy(header + 36, "data", 4);
+    write_u32(header + 40, data_size);
+    fwrite(header, 1, sizeof(header), f);
+
+    uint8_t buf[4096 * 2 * 2];
+    int buf_frames = sizeof(buf) / (channel_count * 2);
+    uint32_t seed = 12345;
+    long frame = 0;
+    while (frame < frame_count) {
+        int n = 0;
+        for (; n < buf_frames && frame < frame_count; n += 1, frame += 1) {
+            double t = frame / (double)source->sample_rate;
+            double swell = 0.6 + 0.4 * sin(2.0 * PI * 0.25 * t);
+            for (int ch = 0; ch < channel_count; ch += 1) {
+                seed = seed * 1664525 + 1013904223;
+                double noise = ((seed >> 8) / 8388608.0 - 1.0) * 0.05;
+                double tone = sin(2.0 * PI * 220.0 * (ch + 2) * t);
+                int16_t sample = (int16_t)((0.5 * tone * swell + noise) * 32767.0);
+                write_u16(buf + (n * channel_count + ch) * 2, (uint16_t)sample);
+            }
+        }
+        fwrite(buf, 1, n * channel_count * 2, f);
+    }
+
+    if (fclose(f))
+        return -1;
+    return 0;
+}
+
+static void destroy_playlist_and_files(struct GroovePlaylist *playlist) {
+    struct GroovePlaylistItem *item = playlist->head;
+    while (item) {
+        struct GrooveFile *file = item->file;
+        struct GroovePlaylistItem *next = item->next;
+        groove_playlist_remove(playlist, item);
+        groove_file_destroy(file);
+        item = next;
+    }
+    groove_playlist_destroy(playlist);
+}
+
+// returns a playlist containing the file at path, or NULL
+static struct GroovePlaylist *open_playlist(struct Groove *groove, const char *path) {
+    struct GroovePlaylist *playlist = groove_playlist_create(groove);
+    if (!playlist)
+        return NULL;
+    struct GrooveFile *file = groove_file_create(groove);
+    if (!file) {
+        groove_playlist_destroy(playlist);
+        return NULL;
+    }
+    if (groove_file_open(file, path, path)) {
+        groove_file_destroy(file);
+        groove_playlist_destroy(playlist);
+        return NULL;
+    }
+    groove_playlist_insert(playlist, file, 1.0, 1.0, NULL);
+    return playlist;
+}
+
+static int encode_file(struct Groove *groove, const char *in_path, const char *out_path,
+        const struct Codec *codec)
+{
+    struct GroovePlaylist *playlist = open_playlist(groove, in_path);
+    if (!playlist)
+        return -1;
+
+    struct GrooveEncoder *encoder = groove_encoder_create(groove);
+    if (!encoder) {
+        destroy_playlist_and_files(playlist);
+        return -1;
+    }
+    encoder->format_short_name = codec->format_short_name;
+    encoder->codec_short_name = codec->codec_short_name;
+    encoder->filename = out_path;
+    groove_file_audio_format(playlist->head->file, &encoder->target_audio_format);
+
+    int err = -1;
+    FILE *f = NULL;
+    if (groove_encoder_attach(encoder, playlist) < 0)
+        goto cleanup;
+    f = fopen(out_path, "wb");
+    if (f) {
+        struct GrooveBuffer *buffer;
+        while (groove_encoder_buffer_get(encoder, &buffer, 1) == GROOVE_BUFFER_YES) {
+            fwrite(buffer->data[0], 1, buffer->size, f);
+            groove_buffer_unref(buffer);
+        }
+        err = fclose(f) ? -1 : 0;
+    }
+    groove_encoder_detach(encoder);
+
+cleanup:
+    groove_encoder_destroy(encoder);
+    destroy_playlist_and_files(playlist);
+    return err;
+}
+
+struct NullSinkGroup {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int remaining;
+};
+
+struct NullSink {
+    struct NullSinkGroup *group;
+    // only touched by the decode thread until it signals the group
+    double audio_seconds;
+};
+
+static void null_sink_push(struct GrooveSink *sink, struct GrooveBuffer *buffer) {
+    struct NullSink *ns = (struct NullSink *)sink->userdata;
+    if (buffer) {
+        ns->audio_seconds += buffer->frame_count / (double)buffer->format.sample_rate;
+        return;
+    }
+    pthread_mutex_lock(&ns->group->mutex);
+    ns->group->remaining -= 1;
+    pthread_cond_signal(&ns->group->cond);
+    pthread_mutex_unlock(&ns->group->mutex);
+}
+
+// decodes stream_count copies of the file at once, one playlist each, into
+// push sinks which throw the audio away. if resample is set, the sinks ask
+// for a sample rate and sample format the file does not have.
+static int decode_into_null_sinks(struct Groove *groove, const char *path, int stream_count,
+        bool resample, struct Measurement *m)
+{
+    struct GroovePlaylist *playlists[MAX_STREAMS];
+    struct GrooveSink *sinks[MAX_STREAMS];
+    struct NullSink null_sinks[MAX_STREAMS];
+    struct NullSinkGroup group;
+    int err = -1;
+
+    pthread_mutex_init(&group.mutex, NULL);
+    pthread_cond_init(&group.cond, NULL);
+    group.remaining = stream_count;
+
+    int open_count = 0;
+    for (; open_count < stream_count; open_count += 1) {
+        struct GroovePlaylist *playlist = open_playlist(groove, path);
+        struct GrooveSink *sink = groove_sink_create(groove);
+        if (!playlist || !sink) {
+            if (playlist) destroy_playlist_and_files(playlist);
+            if (sink) groove_sink_destroy(sink);
+            goto cleanup;
+        }
+        playlists[open_count] = playlist;
+        sinks[open_count] = sink;
+        null_sinks[open_count].group = &group;
+        null_sinks[open_count].audio_seconds = 0.0;
+        sink->userdata = &null_sinks[open_count];
+        sink->push = null_sink_push;
+        if (resample) {
+            struct GrooveAudioFormat in_format;
+            groove_file_audio_format(playlist->head->file, &in_format);
+            struct GrooveAudioFormat format;
+            format.sample_rate = (in_format.sample_rate == 48000) ? 44100 : 48000;
+            format.layout = *soundio_channel_layout_get_builtin(SoundIoChannelLayoutIdStereo);
+            format.format = SoundIoFormatFloat32NE;
+            format.is_planar = 0;
+            groove_sink_set_only_format(sink, &format);
+        }
+    }
+
+    // with no sinks attached the playlists sit idle, so the clock starts here
+    double wall_start = wall_now();
+    double cpu_start = cpu_now();
+    int attach_count = 0;
+    for (; attach_count < stream_count; attach_count += 1) {
+        if (groove_sink_attach(sinks[attach_count], playlists[attach_count]) < 0)
+            break;
+    }
+    pthread_mutex_lock(&group.mutex);
+    group.remaining -= stream_count - attach_count;
+    while (group.remaining > 0)
+        pthread_cond_wait(&group.cond, &group.mutex);
+    pthread_mutex_unlock(&group.mutex);
+    m->wall_seconds = wall_now() - wall_start;
+    m->cpu_seconds = cpu_now() - cpu_start;
+
+    m->audio_seconds = 0.0;
+    for (int i = 0; i < attach_count; i += 1) {
+        m->audio_seconds += null_sinks[i].audio_seconds;
+        groove_sink_detach(sinks[i]);
+    }
+    if (attach_count == stream_count)
+        err = 0;
+
+cleanup:
+    for (int i = 0; i < open_count; i += 1) {
+        groove_sink_destroy(sinks[i]);
+        destroy_playlist_and_files(playlists[i]);
+    }
+    pthread_cond_destroy(&group.cond);
+    pthread_mutex_destroy(&group.mutex);
+    return err;
+}
+
+static int bench_decode(struct Groove *groove, const char *path, int stream_count,
+        struct Measurement *m)
+{
+    return decode_into_null_sinks(groove, path, stream_count, false, m);
+}
+
+static int bench_resample(struct Groove *groove, const char *path, int stream_count,
+        struct Measurement *m)
+{
+    return decode_into_null_sinks(groove, path, stream_count, true, m);
+}
+
+static int bench_transcode(struct Groove *groove, const char *path, int stream_count,
+        struct Measurement *m)
+{
+    struct GroovePlaylist *playlist = open_playlist(groove, path);
+    if (!playlist)
+        return -1;
+    struct GrooveEncoder *encoder = groove_encoder_create(groove);
+    if (!encoder) {
+        destroy_playlist_and_files(playlist);
+        return -1;
+    }
+    encoder->format_short_name = "mp3";
+    encoder->bit_rate = 256 * 1000;
+    m->audio_seconds = groove_file_duration(playlist->head->file);
+
+    int err = -1;
+    double wall_start = wall_now();
+    double cpu_start = cpu_now();
+    if (groove_encoder_attach(encoder, playlist) >= 0) {
+        struct GrooveBuffer *buffer;
+        while (groove_encoder_buffer_get(encoder, &buffer, 1) == GROOVE_BUFFER_YES)
+            groove_buffer_unref(buffer);
+        m->wall_seconds = wall_now() - wall_start;
+        m->cpu_seconds = cpu_now() - cpu_start;
+        groove_encoder_detach(encoder);
+        err = 0;
+    }
+
+    groove_encoder_destroy(encoder);
+    destroy_playlist_and_files(playlist);
+    return err;
+}
+
+static int bench_loudness(struct Groove *groove, const char *path, int stream_count,
+        struct Measurement *m)
+{
+    struct GroovePlaylist *playlist = open_playlist(groove, path);
+    if (!playlist)
+        return -1;
+    struct GrooveLoudnessDetector *detector = groove_loudness_detector_create(groove);
+    if (!detector) {
+        destroy_playlist_and_files(playlist);
+        return -1;
+    }
+    m->audio_seconds = groove_file_duration(playlist->head->file);
+
+    int err = -1;
+    double wall_start = wall_now();
+    double cpu_start = cpu_now();
+    if (groove_loudness_detector_attach(detector, playlist) >= 0) {
+        struct GrooveLoudnessDetectorInfo info;
+        while (groove_loudness_detector_info_get(detector, &info, 1) == 1) {
+            if (!info.item)
+                break;
+        }
+        m->wall_seconds = wall_now() - wall_start;
+        m->cpu_seconds = cpu_now() - cpu_start;
+        groove_loudness_detector_detach(detector);
+        err = 0;
+    }
+
+    groove_loudness_detector_destroy(detector);
+    destroy_playlist_and_files(playlist);
+    return err;
+}
+
+static int bench_waveform(struct Groove *groove, const char *path, int stream_count,
+        struct Measurement *m)
+{
+    struct GroovePlaylist *playlist = open_playlist(groove, path);
+    if (!playlist)
+        return -1;
+    struct GrooveWaveform *waveform = groove_waveform_create(groove);
+    if (!waveform) {
+        destroy_playlist_and_files(playlist);
+        return -1;
+    }
+    m->audio_seconds = groove_file_duration(playlist->head->file);
+
+    int err = -1;
+    double wall_start = wall_now();
+    double cpu_start = cpu_now();
+    if (groove_waveform_attach(waveform, playlist) >= 0) {
+        struct GrooveWaveformInfo *info;
+        while (groove_waveform_info_get(waveform, &info, 1) == 1) {
+            bool end = !info->item;
+            groove_waveform_info_unref(info);
+            if (end)
+                break;
+        }
+        m->wall_seconds = wall_now() - wall_start;
+        m->cpu_seconds = cpu_now() - cpu_start;
+        groove_waveform_detach(waveform);
+        err = 0;
+    }
+
+    groove_waveform_destroy(waveform);
+    destroy_playlist_and_files(playlist);
+    return err;
+}
+
+static int bench_fingerprint(struct Groove *groove, const char *path, int stream_count,
+        struct Measurement *m)
+{
+    struct GroovePlaylist *playlist = open_playlist(groove, path);
+    if (!playlist)
+        return -1;
+    struct GrooveFingerprinter *printer = groove_fingerprinter_create(groove);
+    if (!printer) {
+        destroy_playlist_and_files(playlist);
+        return -1;
+    }
+    m->audio_seconds = groove_file_duration(playlist->head->file);
+
+    int err = -1;
+    double wall_start = wall_now();
+    double cpu_start = cpu_now();
+    if (groove_fingerprinter_attach(printer, playlist) >= 0) {
+        struct GrooveFingerprinterInfo info;
+        while (groove_fingerprinter_info_get(printer, &info, 1) == 1) {
+            bool end = !info.item;
+            groove_fingerprinter_free_info(&info);
+            if (end)
+                break;
+        }
+        m->wall_seconds = wall_now() - wall_start;
+        m->cpu_seconds = cpu_now() - cpu_start;
+        groove_fingerprinter_detach(printer);
+        err = 0;
+    }
+
+    groove_fingerprinter_destroy(printer);
+    destroy_playlist_and_files(playlist);
+    return err;
+}
+
+static void print_result_start(const char *name, const char *input) {
+    fprintf(out, "%s\n    {\"name\": \"%s\", \"input\": \"%s\"", first_result ? "" : ",",
+            name, input);
+    first_result = false;
+}
+
+// runs a benchmark `runs` times and reports the fastest run
+static void run_bench(struct Groove *groove, const char *name, BenchFn fn,
+        const struct Input *input, int stream_count, int runs)
+{
+    fprintf(stderr, "%s %s x%d\n", name, input->name, stream_count);
+
+    struct Measurement best = {0.0, 0.0, 0.0};
+    bool have_best = false;
+    for (int run = 0; run < runs; run += 1) {
+        struct Measurement m;
+        if (fn(groove, input->path, stream_count, &m))
+            break;
+        if (!have_best || m.wall_seconds < best.wall_seconds)
+            best = m;
+        have_best = true;
+    }
+
+    print_result_start(name, input->name);
+    if (!have_best) {
+        fprintf(out, ", \"streams\": %d, \"error\": \"benchmark failed\"}", stream_count);
+        return;
+    }
+    double wall = (best.wall_seconds > 0.0) ? best.wall_seconds : 1e-9;
+    fprintf(out, ", \"streams\": %d, \"audio_seconds\": %.3f, \"wall_seconds\": %.6f, "
+            "\"cpu_seconds\": %.6f, \"audio_seconds_per_second\": %.3f, "
+            "\"cpu_seconds_per_stream\": %.6f}",
+            stream_count, best.audio_seconds, best.wall_seconds, best.cpu_seconds,
+            best.audio_seconds / wall, best.cpu_seconds / stream_count);
+}
+
+static bool selected(const char *filter, const char *name) {
+    return !filter || strstr(name, filter);
+}
+
+int main(int argc, char * argv[]) {
+    double seconds = 30.0;
+    int runs = 3;
+    long cpu_count = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_streams = (cpu_count > 0) ? (int)cpu_count : 4;
+    const char *filter = NULL;
+    const char *output_file_name = NULL;
+    const char *dir_arg = NULL;
+    bool keep = false;
+
+    for (int i = 1; i < argc; i += 1) {
+        char *arg = argv[i];
+        if (strcmp(arg, "--keep") == 0) {
+            keep = true;
+        } else if (arg[0] == '-' && arg[1] == '-') {
+            arg += 2;
+            if (i + 1 >= argc) {
+                return usage(argv[0]);
+            } else if (strcmp(arg, "seconds") == 0) {
+                seconds = atof(argv[++i]);
+            } else if (strcmp(arg, "runs") == 0) {
+                runs = atoi(argv[++i]);
+            } else if (strcmp(arg, "streams") == 0) {
+                max_streams = atoi(argv[++i]);
+            } else if (strcmp(arg, "filter") == 0) {
+                filter = argv[++i];
+            } else if (strcmp(arg, "output") == 0) {
+                output_file_name = argv[++i];
+            } else if (strcmp(arg, "dir") == 0) {
+                dir_arg = argv[++i];
+            } else {
+                return usage(argv[0]);
+            }
+        } else {
+            return usage(argv[0]);
+        }
+    }
+    if (seconds <= 0.0 || runs < 1 || max_streams < 1)
+        return usage(argv[0]);
+    if (max_streams > MAX_STREAMS)
+        max_streams = MAX_STREAMS;
+
+    char dir[512];
+    if (dir_arg) {
+        snprintf(dir, sizeof(dir), "%s", dir_arg);
+    } else {
+        const char *tmp = getenv("TMPDIR");
+        snprintf(dir, sizeof(dir), "%s/groove-bench-XXXXXX", tmp ? tmp : "/tmp");
+        if (!mkdtemp(dir)) {
+            fprintf(stderr, "unable to create temporary directory\n");
+            return 1;
+        }
+    }
+
+    out = stdout;
+    if (output_file_name) {
+        out = fopen(output_file_name, "w");
+        if (!out) {
+            fprintf(stderr, "Error opening output file %s\n", output_file_name);
+            return 1;
+        }
+    }
+
+    struct Groove *groove;
+    int err;
+    if ((err = groove_create(&groove))) {
+        fprintf(stderr, "unable to initialize libgroove: %s\n", groove_strerror(err));
+        return 1;
+    }
+    groove_set_logging(GROOVE_LOG_ERROR);
+
+    // render the inputs
+    static struct Input inputs[SOURCE_COUNT * CODEC_COUNT];
+    static char input_names[SOURCE_COUNT * CODEC_COUNT][64];
+    int input_count = 0;
+    for (int s = 0; s < SOURCE_COUNT; s += 1) {
+        const struct Source *source = &sources[s];
+        char wav_path[512];
+        snprintf(wav_path, sizeof(wav_path), "%s/source_%d_%dch.wav", dir,
+                source->sample_rate, source->channel_count);
+        if (render_source_wav(wav_path, source, seconds)) {
+            fprintf(stderr, "unable to write %s\n", wav_path);
+            continue;
+        }
+        for (int c = 0; c < CODEC_COUNT; c += 1) {
+            const struct Codec *codec = &codecs[c];
+            struct Input *input = &inputs[input_count];
+            snprintf(input_names[input_count], sizeof(input_names[input_count]),
+                    "%d_%dch.%s", source->sample_rate, source->channel_count, codec->ext);
+            input->name = input_names[input_count];
+            input_count += 1;
+            if (!codec->format_short_name) {
+                snprintf(input->path, sizeof(input->path), "%s", wav_path);
+                input->ok = true;
+                continue;
+            }
+            snprintf(input->path, sizeof(input->path), "%s/%s", dir, input->name);
+            fprintf(stderr, "rendering %s\n", input->name);
+            input->ok = (encode_file(groove, wav_path, input->path, codec) == 0);
+            if (!input->ok)
+                fprintf(stderr, "unable to encode %s, skipping it\n", input->name);
+        }
+    }
+
+    static const struct {
+        const char *name;
+        BenchFn fn;
+    } benches[] = {
+        {"decode", bench_decode},
+        {"resample", bench_resample},
+        {"transcode", bench_transcode},
+        {"loudness", bench_loudness},
+        {"waveform", bench_waveform},
+        {"fingerprint", bench_fingerprint},
+    };
+    int bench_count = (int)(sizeof(benches) / sizeof(benches[0]));
+
+    fprintf(out, "{\n  \"libgroove\": \"%s\",\n  \"input_seconds\": %.3f,\n  \"runs\": %d,\n"
+            "  \"results\": [", groove_version(), seconds, runs);
+
+    for (int b = 0; b < bench_count; b += 1) {
+        if (!selected(filter, benches[b].name))
+            continue;
+        for (int i = 0; i < input_count; i += 1) {
+            if (inputs[i].ok)
+                run_bench(groove, benches[b].name, benches[b].fn, &inputs[i], 1, runs);
+        }
+    }
+
+    // concurrent playlists all decode the first input of the most common
+    // kind, 44.1kHz stereo mp3, falling back to the first one that rendered
+    if (selected(filter, "concurrent")) {
+        const struct Input *input = NULL;
+        for (int i = 0; i < input_count && !input; i += 1) {
+            if (inputs[i].ok && strcmp(inputs[i].name, "44100_2ch.mp3") == 0)
+                input = &inputs[i];
+        }
+        for (int i = 0; i < input_count && !input; i += 1) {
+            if (inputs[i].ok)
+                input = &inputs[i];
+        }
+        // 1, 2, 4, ... streams, finishing with max_streams
+        int stream_count = 1;
+        while (input) {
+            run_bench(groove, "concurrent", bench_decode, input, stream_count, runs);
+            if (stream_count == max_streams)
+                break;
+            stream_count = (stream_count * 2 < max_streams) ? stream_count * 2 : max_streams;
+        }
+    }
+
+    fprintf(out, "\n  ]\n}\n");
+    if (out != stdout)
+        fclose(out);
+
+    groove_destroy(groove);
+
+    if (!keep && !dir_arg) {
+        for (int i = 0; i < input_count; i += 1) {
+            if (strstr(inputs[i].path, dir) == inputs[i].path)
+                remove(inputs[i].path);
+        }
+        rmdir(dir);
+    }
+
+    return 0;
+}
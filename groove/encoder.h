@@ -85,10 +85,25 @@ GROOVE_EXPORT int groove_encoder_detach(struct GrooveEncoder *encoder);
 GROOVE_EXPORT int groove_encoder_buffer_get(struct GrooveEncoder *encoder,
         struct GrooveBuffer **buffer, int block);
 
+/// Like ::groove_encoder_buffer_get, but waits at most `seconds` for a buffer.
+/// See ::groove_sink_buffer_get_timeout.
+GROOVE_EXPORT int groove_encoder_buffer_get_timeout(struct GrooveEncoder *encoder,
+        struct GrooveBuffer **buffer, double seconds);
+
 /// returns < 0 on error, 0 on no buffer ready, 1 on buffer ready
 /// if block is 1, block until buffer is ready
 GROOVE_EXPORT int groove_encoder_buffer_peek(struct GrooveEncoder *encoder, int block);
 
+/// Returns a file descriptor which is readable whenever
+/// ::groove_encoder_buffer_get would not block. See ::groove_sink_get_fd.
+GROOVE_EXPORT int groove_encoder_get_fd(struct GrooveEncoder *encoder);
+
+/// Fills `sink_stats` with the counters of the encoder's internal sink, which
+/// feeds it decoded audio, and `queue_stats` with the counters of its queue
+/// of encoded buffers. Either may be `NULL`. See ::groove_sink_get_stats.
+GROOVE_EXPORT void groove_encoder_get_stats(struct GrooveEncoder *encoder,
+        struct GrooveSinkStats *sink_stats, struct GrooveQueueStats *queue_stats);
+
 /// see docs for groove_file_metadata_get
 GROOVE_EXPORT struct GrooveTag *groove_encoder_metadata_get(struct GrooveEncoder *encoder,
         const char *key, const struct GrooveTag *prev, int flags);
@@ -56,6 +56,11 @@ GROOVE_EXPORT int groove_fingerprinter_detach(struct GrooveFingerprinter *printe
 GROOVE_EXPORT int groove_fingerprinter_info_get(struct GrooveFingerprinter *printer,
         struct GrooveFingerprinterInfo *info, int block);
 
+/// Like ::groove_fingerprinter_info_get, but waits at most `seconds` for info,
+/// returning 0 if the timeout expires first. See ::groove_sink_buffer_get_timeout.
+GROOVE_EXPORT int groove_fingerprinter_info_get_timeout(struct GrooveFingerprinter *printer,
+        struct GrooveFingerprinterInfo *info, double seconds);
+
 GROOVE_EXPORT void groove_fingerprinter_free_info(struct GrooveFingerprinterInfo *info);
 
 /// returns < 0 on error, 0 on no info ready, 1 on info ready
@@ -63,6 +68,15 @@ GROOVE_EXPORT void groove_fingerprinter_free_info(struct GrooveFingerprinterInfo
 GROOVE_EXPORT int groove_fingerprinter_info_peek(struct GrooveFingerprinter *printer,
         int block);
 
+/// Returns a file descriptor which is readable whenever
+/// ::groove_fingerprinter_info_get would not block. See ::groove_sink_get_fd.
+GROOVE_EXPORT int groove_fingerprinter_get_fd(struct GrooveFingerprinter *printer);
+
+/// Fills `stats` with the counters of the fingerprinter's internal sink.
+/// See ::groove_sink_get_stats.
+GROOVE_EXPORT void groove_fingerprinter_get_stats(struct GrooveFingerprinter *printer,
+        struct GrooveSinkStats *stats);
+
 /// get the position of the printer head
 /// both the current playlist item and the position in seconds in the playlist
 /// item are given. item will be set to NULL if the playlist is empty
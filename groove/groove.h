@@ -89,6 +89,7 @@ enum GrooveError {
     GrooveErrorEncoderNotFound      = -17,
     GrooveErrorOpeningDevice        = -18,
     GrooveErrorDeviceParams         = -19,
+    GrooveErrorUnsupported          = -20,
 };
 
 /// Specifies when the sink will stop decoding.
@@ -313,6 +314,24 @@ struct GrooveSink {
     /// ::groove_sink_create defaults this to 64KB
     int buffer_size_bytes;
 
+    /// Once the sink holds GrooveSink::buffer_size_bytes, the playlist stops
+    /// decoding and does not wake up again until the sink has drained below
+    /// this many bytes. It then refills the sink in one go. Leave this at 0
+    /// to use half of GrooveSink::buffer_size_bytes.
+    int buffer_low_watermark_bytes;
+
+    /// If you set this to a positive number, the sink is sized by duration
+    /// rather than by bytes: it is full once it holds this many seconds of
+    /// audio, whatever the sample format and channel count, and
+    /// GrooveSink::buffer_size_bytes is ignored. Defaults to 0.
+    /// To change this while the sink is attached, use
+    /// ::groove_sink_set_buffer_size_seconds.
+    double buffer_size_seconds;
+
+    /// Low watermark in seconds, used when GrooveSink::buffer_size_seconds is
+    /// set. Leave this at 0 to use half of GrooveSink::buffer_size_seconds.
+    double buffer_low_watermark_seconds;
+
     /// This volume adjustment only applies to this sink.
     /// It is recommended that you leave this at 1.0 and instead adjust the
     /// gain of the playlist.
@@ -337,11 +356,59 @@ struct GrooveSink {
     /// context in which it is undefined behavior to call any libgroove functions.
     void (*filled)(struct GrooveSink *);
 
+    /// If set, the sink is a push sink. Instead of being queued, each buffer
+    /// is passed to this function on the playlist's decode thread as soon as
+    /// it is decoded, and ::groove_sink_buffer_get never returns a buffer.
+    /// At the end of the playlist it is called with `buffer` set to `NULL`.
+    ///
+    /// `buffer` is borrowed for the duration of the call. Use
+    /// ::groove_buffer_ref if you need to keep it longer.
+    ///
+    /// Decoding for every sink on the playlist waits for this function to
+    /// return, so it must be quick and must never block. It is undefined
+    /// behavior to call any libgroove function from it other than
+    /// ::groove_buffer_ref. A push sink is never full, so it does not hold
+    /// back decoding; the playlist decodes as fast as its other sinks allow.
+    /// `filled` is not called for push sinks. Set this before calling
+    /// ::groove_sink_attach.
+    void (*push)(struct GrooveSink *, struct GrooveBuffer *buffer);
+
     /// read-only. set when you call ::groove_sink_attach. cleared when you call
     /// ::groove_sink_detach
     struct GroovePlaylist *playlist;
 };
 
+/// Cumulative counters for one of libgroove's internal queues, such as the
+/// buffer queue of a sink. They are always on and cheap to read.
+struct GrooveQueueStats {
+    /// number of items put into the queue
+    int64_t put_count;
+    /// number of items taken out of the queue by a get
+    int64_t get_count;
+    /// number of gets and peeks which had to wait for an item to arrive
+    int64_t wait_count;
+    /// total time spent in those waits, in seconds
+    double wait_seconds;
+    /// the most items ever queued at once
+    int64_t max_items;
+    /// the most bytes ever queued at once, or 0 if the queue does not hold
+    /// buffers
+    int64_t max_bytes;
+    /// number of times items were purged because a playlist item was removed
+    int64_t purge_count;
+    /// number of times the queue was flushed, for example by a seek
+    int64_t flush_count;
+};
+
+struct GrooveSinkStats {
+    /// counters for the queue of buffers waiting in the sink
+    struct GrooveQueueStats queue;
+    /// number of times the playlist's decode thread went to sleep while
+    /// this sink was full. The sink whose count climbs is the one holding
+    /// decoding back.
+    int64_t decode_sleep_count;
+};
+
 
 /// You should only need one of these Groove contexts.
 ///
@@ -356,6 +423,47 @@ GROOVE_EXPORT const char *groove_strerror(int error);
 /// enable/disable logging of errors
 GROOVE_EXPORT void groove_set_logging(int level);
 
+/// Starts recording timestamped events from every libgroove thread: the
+/// playlist decode threads, the player's helper thread and audio callback,
+/// and the encoder and analysis threads. Each thread keeps its most recent
+/// `events_per_thread` events in a ring buffer of its own, so recording
+/// takes no locks. While tracing is stopped, the cost is a single relaxed
+/// atomic load at each trace point. Calling this again clears the events
+/// recorded so far. A thread that exits may have its ring reused by a new
+/// thread.
+///
+/// Possible errors:
+/// * #GrooveErrorInvalid - events_per_thread is not positive
+GROOVE_EXPORT int groove_trace_start(int events_per_thread);
+
+/// Stops recording trace events. Events recorded so far are kept for
+/// ::groove_trace_dump.
+GROOVE_EXPORT void groove_trace_stop(void);
+
+/// Writes the events recorded since ::groove_trace_start to `filename` in
+/// the Chrome trace event JSON format, which chrome://tracing and Perfetto
+/// can open. May be called while tracing is running.
+///
+/// Possible errors:
+/// * #GrooveErrorFileSystem
+/// * #GrooveErrorNoMem
+GROOVE_EXPORT int groove_trace_dump(const char *filename);
+
+/// Limit the total number of bytes of decoded audio, across every playlist
+/// created with this Groove, that may be queued in sinks or held by
+/// consumers at once. When the budget is used up, playlists stop decoding
+/// until enough buffers have been freed. A playlist may overshoot by one
+/// packet's worth of audio. Make sure the budget is large enough to fill the
+/// sinks you expect to be active at the same time, or they will wait on
+/// each other forever.
+/// 0 means no limit, which is the default.
+GROOVE_EXPORT void groove_set_buffer_budget(struct Groove *groove, int64_t bytes);
+
+/// Returns the number of bytes of decoded audio currently charged against
+/// the budget. See also ::groove_playlist_get_buffer_usage and
+/// ::groove_sink_get_fill_level.
+GROOVE_EXPORT int64_t groove_get_buffer_usage(struct Groove *groove);
+
 
 /// returns 1 if the audio formats have the same sample rate, channel layout,
 /// and sample format. returns 0 otherwise.
@@ -450,10 +558,23 @@ GROOVE_EXPORT struct GroovePlaylistItem *groove_playlist_insert(
         struct GroovePlaylistItem *next);
 
 /// This will not call ::groove_file_close on item->file
-/// Item is destroyed and the address it points to is no longer valid
+/// Item is destroyed and the address it points to is no longer valid.
+/// Use ::groove_playlist_item_handle if you need to refer to an item which
+/// might be removed out from under you.
 GROOVE_EXPORT void groove_playlist_remove(struct GroovePlaylist *playlist,
         struct GroovePlaylistItem *item);
 
+/// Returns a handle which identifies `item` within its playlist. Unlike the
+/// item pointer, a handle is safe to keep after the item is removed; pass it
+/// to ::groove_playlist_item_from_handle to find out whether the item still
+/// exists. A valid handle is never 0.
+GROOVE_EXPORT uint64_t groove_playlist_item_handle(struct GroovePlaylistItem *item);
+
+/// Returns the playlist item that `handle` refers to, or `NULL` if that item
+/// has been removed from the playlist.
+GROOVE_EXPORT struct GroovePlaylistItem *groove_playlist_item_from_handle(
+        struct GroovePlaylist *playlist, uint64_t handle);
+
 /// Get the position of the decode head
 /// both the current playlist item and the position in seconds in the playlist
 /// item are given. item will be set to NULL if the playlist is empty
@@ -465,6 +586,61 @@ GROOVE_EXPORT void groove_playlist_remove(struct GroovePlaylist *playlist,
 GROOVE_EXPORT void groove_playlist_position(struct GroovePlaylist *playlist,
         struct GroovePlaylistItem **item, double *seconds);
 
+/// Returns the number of bytes of decoded audio from this playlist which are
+/// still queued in sinks or held by consumers. A buffer shared by several
+/// sinks is counted once.
+GROOVE_EXPORT int64_t groove_playlist_get_buffer_usage(struct GroovePlaylist *playlist);
+
+/// Time spent in, and work done by, one stage of a playlist's decode thread.
+struct GroovePipelineStageStats {
+    /// total time spent in this stage, in seconds
+    double seconds;
+    /// number of bytes this stage produced
+    int64_t bytes;
+    /// number of packets, frames or buffers this stage produced
+    int64_t count;
+};
+
+/// Cumulative counters for a playlist's decode thread.
+/// See ::groove_playlist_get_stats.
+struct GroovePlaylistStats {
+    /// reading compressed packets from files
+    struct GroovePipelineStageStats demux;
+    /// decoding packets into frames of audio
+    struct GroovePipelineStageStats decode;
+    /// running frames through the filter graph, which resamples, converts
+    /// and applies gain, and wrapping the output in buffers
+    struct GroovePipelineStageStats filter;
+    /// handing buffers to sinks; count is the number of buffers delivered,
+    /// once for each sink
+    struct GroovePipelineStageStats queue;
+
+    /// number of times the filter graph was built, and the total time spent
+    /// building it, in seconds
+    int64_t filter_graph_build_count;
+    double filter_graph_build_seconds;
+
+    /// number of seeks carried out, and the total and greatest time between
+    /// ::groove_playlist_seek and the decode thread acting on it, in seconds
+    int64_t seek_count;
+    double seek_latency_seconds;
+    double max_seek_latency_seconds;
+
+    /// seconds of audio decoded
+    double audio_seconds;
+    /// seconds of audio decoded per second spent in the stages above, which
+    /// excludes time spent waiting for sinks to drain
+    double realtime_factor;
+    /// the same two values, for the playlist item currently being decoded
+    double item_audio_seconds;
+    double item_realtime_factor;
+};
+
+/// Fills `stats` with the counters of the playlist's decode thread since the
+/// playlist was created.
+GROOVE_EXPORT void groove_playlist_get_stats(struct GroovePlaylist *playlist,
+        struct GroovePlaylistStats *stats);
+
 /// return 1 if the playlist is playing; 0 if it is not.
 GROOVE_EXPORT int groove_playlist_playing(struct GroovePlaylist *playlist);
 
@@ -520,6 +696,23 @@ GROOVE_EXPORT int groove_sink_detach(struct GrooveSink *sink);
 GROOVE_EXPORT int groove_sink_buffer_get(struct GrooveSink *sink,
         struct GrooveBuffer **buffer, int block);
 
+/// Like ::groove_sink_buffer_get, but waits at most `seconds` for a buffer.
+/// Returns #GROOVE_BUFFER_NO if the timeout expires first. A negative or
+/// infinite timeout waits forever, like block=1, and 0 does not wait, like
+/// block=0.
+GROOVE_EXPORT int groove_sink_buffer_get_timeout(struct GrooveSink *sink,
+        struct GrooveBuffer **buffer, double seconds);
+
+/// Like ::groove_sink_buffer_get, but takes up to `max_count` buffers at once
+/// with a single lock acquisition. If block is 1, blocks until at least one
+/// buffer is ready.
+/// Returns the number of entries written to `buffers`, which is 0 on aborted
+/// (block=1) or no buffer ready (block=0), or < 0 on error. When the end of
+/// the playlist is reached the last entry written is `NULL`, in place of
+/// #GROOVE_BUFFER_END.
+GROOVE_EXPORT int groove_sink_buffer_get_many(struct GrooveSink *sink,
+        struct GrooveBuffer **buffers, int max_count, int block);
+
 /// returns < 0 on error, 0 on no buffer ready, 1 on buffer ready
 /// if block is 1, block until buffer is ready
 GROOVE_EXPORT int groove_sink_buffer_peek(struct GrooveSink *sink, int block);
@@ -530,13 +723,43 @@ GROOVE_EXPORT int groove_sink_buffer_peek(struct GrooveSink *sink, int block);
 GROOVE_EXPORT int groove_sink_set_gain(struct GrooveSink *sink, double gain);
 
 /// Set the buffer_size_bytes field of the sink while the sink is attached.
+/// This also recomputes the low watermark from
+/// GrooveSink::buffer_low_watermark_bytes.
 GROOVE_EXPORT void groove_sink_set_buffer_size_bytes(struct GrooveSink *sink, int buffer_size_bytes);
 
+/// Set the buffer_size_seconds field of the sink while the sink is attached.
+GROOVE_EXPORT void groove_sink_set_buffer_size_seconds(struct GrooveSink *sink,
+        double buffer_size_seconds);
+
 /// Returns the number of bytes contained in this sink.
 GROOVE_EXPORT int groove_sink_get_fill_level(struct GrooveSink *sink);
 
+/// Returns the duration in seconds of the audio contained in this sink.
+GROOVE_EXPORT double groove_sink_get_fill_duration(struct GrooveSink *sink);
+
+/// Returns 1 if the sink has reached its buffer size, measured in seconds if
+/// GrooveSink::buffer_size_seconds is set and in bytes otherwise. Returns 0
+/// otherwise.
+GROOVE_EXPORT int groove_sink_is_full(struct GrooveSink *sink);
+
 /// Returns 1 if the sink contains the end of playlist sentinel, 0 otherwise.
 GROOVE_EXPORT int groove_sink_contains_end_of_playlist(struct GrooveSink *sink);
 
+/// Fills `stats` with the counters of this sink since it was created.
+/// Safe to call from any thread at any time.
+GROOVE_EXPORT void groove_sink_get_stats(struct GrooveSink *sink, struct GrooveSinkStats *stats);
+
+/// Returns a file descriptor which is readable whenever
+/// ::groove_sink_buffer_get would not block, so that you can wait on many
+/// sinks at once with poll, select or epoll. Edge triggered epoll works too;
+/// the descriptor becomes readable once each time the sink goes from empty
+/// to not empty. The sink owns the descriptor: do not read from it or close
+/// it. It stays the same for the lifetime of the sink.
+///
+/// Possible errors:
+/// * #GrooveErrorSystemResources
+/// * #GrooveErrorUnsupported - only available on Linux
+GROOVE_EXPORT int groove_sink_get_fd(struct GrooveSink *sink);
+
 
 #endif
@@ -65,11 +65,28 @@ GROOVE_EXPORT int groove_loudness_detector_detach(struct GrooveLoudnessDetector
 GROOVE_EXPORT int groove_loudness_detector_info_get(struct GrooveLoudnessDetector *detector,
         struct GrooveLoudnessDetectorInfo *info, int block);
 
+/// Like ::groove_loudness_detector_info_get, but waits at most `seconds` for
+/// info, returning 0 if the timeout expires first.
+/// See ::groove_sink_buffer_get_timeout.
+GROOVE_EXPORT int groove_loudness_detector_info_get_timeout(
+        struct GrooveLoudnessDetector *detector,
+        struct GrooveLoudnessDetectorInfo *info, double seconds);
+
 /// returns < 0 on error, 0 on no info ready, 1 on info ready
 /// if block is 1, block until info is ready
 GROOVE_EXPORT int groove_loudness_detector_info_peek(struct GrooveLoudnessDetector *detector,
         int block);
 
+/// Returns a file descriptor which is readable whenever
+/// ::groove_loudness_detector_info_get would not block.
+/// See ::groove_sink_get_fd.
+GROOVE_EXPORT int groove_loudness_detector_get_fd(struct GrooveLoudnessDetector *detector);
+
+/// Fills `stats` with the counters of the detector's internal sink.
+/// See ::groove_sink_get_stats.
+GROOVE_EXPORT void groove_loudness_detector_get_stats(struct GrooveLoudnessDetector *detector,
+        struct GrooveSinkStats *stats);
+
 /// get the position of the detect head
 /// both the current playlist item and the position in seconds in the playlist
 /// item are given. item will be set to NULL if the playlist is empty
@@ -45,7 +45,8 @@ union GroovePlayerEvent {
 };
 
 struct GroovePlayer {
-    /// Set this to the device you want to open.
+    /// Set this to the device you want to open. Ignored if
+    /// use_virtual_device is 1.
     struct SoundIoDevice *device;
 
     /// Volume adjustment to make to this player.
@@ -59,11 +60,116 @@ struct GroovePlayer {
     /// Stream name. Used for some system's volume mixer interfaces.
     const char *name;
 
+    /// How many seconds of audio the device buffers. Lower values make
+    /// pausing and seeking respond sooner but risk underruns. Clamped to the
+    /// device's `software_latency_min` and `software_latency_max`.
+    /// Read when you call ::groove_player_attach. Defaults to 0.025
+    double target_latency;
+
+    /// How many seconds of decoded audio to keep queued up ahead of the
+    /// device. Whatever is queued is thrown away on a seek, so lower values
+    /// make seeking and skipping cheaper, while higher values ride out
+    /// slow decoding better. Never less than twice target_latency.
+    /// Read when you call ::groove_player_attach. Defaults to 2.0
+    double buffer_duration;
+
+    /// Playback starts, and resumes after a buffer underrun, once this many
+    /// seconds are decoded or buffer_duration is reached, whichever is first.
+    /// Read when you call ::groove_player_attach. Defaults to 2.0
+    double prebuffer_duration;
+
+    /// Set this to 1 to have the player size the queue by itself, between
+    /// min_buffer_duration and buffer_duration. It starts out small, doubles
+    /// after each buffer underrun or near miss, and shrinks back by a quarter
+    /// after every half minute of steady playback. This suits machines whose
+    /// load comes and goes. See ::groove_player_get_buffer_duration.
+    /// Read when you call ::groove_player_attach. Defaults to 0
+    int use_adaptive_buffering;
+
+    /// With use_adaptive_buffering, the fewest seconds of decoded audio to
+    /// keep queued. Never less than twice target_latency.
+    /// Read when you call ::groove_player_attach. Defaults to 0.5
+    double min_buffer_duration;
+
+    /// Normally the device is closed and re-opened, leaving a short gap,
+    /// whenever the audio format changes, and closed at the end of the
+    /// playlist. Set this to 1 to instead choose the device format once when
+    /// you call ::groove_player_attach and have the playlist convert all
+    /// audio to it, which keeps playback gapless across sample rates. The
+    /// device is then only re-opened by ::groove_player_reopen_device.
+    /// Defaults to 0
+    int use_fixed_format;
+
+    /// With use_fixed_format, the sample rate to open the device at, or the
+    /// nearest one it supports. Read when you call ::groove_player_attach.
+    /// Defaults to 44100
+    int fixed_sample_rate;
+
+    /// Set this to 1 to play into a built-in virtual device instead of
+    /// `device`, for example to test or benchmark on a machine with no sound
+    /// card. A timer thread plays the audio into nothing on schedule, going
+    /// through the same buffering as a real device, and accepts any audio
+    /// format. See ::groove_player_get_virtual_device_stats.
+    /// Read when you call ::groove_player_attach. Defaults to 0
+    int use_virtual_device;
+
+    /// How many seconds of audio the virtual device plays per second. Values
+    /// above 1.0 run faster than realtime, and values very close to 1.0
+    /// imitate a sound card whose clock runs fast or slow.
+    /// Read when you call ::groove_player_attach. Defaults to 1.0
+    double virtual_speed;
+
+    /// Other devices to play the same audio on at the same time as `device`.
+    /// Each one is resampled by up to 0.2% to follow the clock of `device`,
+    /// which keeps them within a few milliseconds of it. They must support
+    /// the channel layout `device` plays. Having any implies
+    /// use_fixed_format. See ::groove_player_get_extra_device_stats.
+    /// Read when you call ::groove_player_attach.
+    struct SoundIoDevice **extra_devices;
+    int extra_device_count;
+
+    /// Set this to 1 to have the playlist hand the player 32-bit float audio,
+    /// which the audio callback then converts to the device's sample format,
+    /// interleaves and scales by `gain` in the same pass that writes it to
+    /// the device. This saves the playlist a pass over the audio for each of
+    /// those steps, which helps where memory bandwidth is scarce, and
+    /// ::groove_player_set_gain takes effect without rebuilding the filter
+    /// graph. A gain above 1.0 clips rather than compresses. Best when the
+    /// player is the only sink on the playlist. Cannot be combined with
+    /// extra_devices.
+    /// Read when you call ::groove_player_attach. Defaults to 0
+    int use_direct_render;
+
     /// Read-only. Set when you call ::groove_player_attach and cleared when
     /// you call ::groove_player_detach
     struct GroovePlaylist *playlist;
 };
 
+struct GrooveVirtualDeviceStats {
+    /// number of times the device asked the player for audio
+    int64_t callback_count;
+    /// total time spent in those requests, in seconds
+    double callback_seconds;
+    /// longest time spent in one request, in seconds
+    double callback_max_seconds;
+    /// total time by which the timer thread woke up late to play a period of
+    /// the buffer, in seconds. Divide by callback_count for the average
+    /// jitter.
+    double lateness_seconds;
+    /// latest the timer thread woke up, in seconds
+    double lateness_max_seconds;
+    /// number of times the device ran out of audio and played silence
+    int64_t underrun_count;
+    /// number of frames the device has played, including silence
+    int64_t frames_played;
+    /// how far ::groove_player_position has moved beyond the audio the
+    /// device actually played, in seconds, added up over every stretch of
+    /// playing one item without an underrun. It wanders by up to a period
+    /// of the buffer; a steady trend means the reported position runs fast
+    /// or slow.
+    double drift_seconds;
+};
+
 GROOVE_EXPORT struct GroovePlayer *groove_player_create(struct Groove *groove);
 GROOVE_EXPORT void groove_player_destroy(struct GroovePlayer *player);
 
@@ -84,16 +190,65 @@ GROOVE_EXPORT int groove_player_detach(struct GroovePlayer *player);
 /// you may pass NULL for item or seconds
 /// seconds might be negative, to compensate for the latency of the sound
 /// card buffer.
+/// This never waits for the audio thread, and between audio callbacks the
+/// position is moved on by the time that has passed, so it is cheap and
+/// smooth enough to call on every frame of a user interface.
 GROOVE_EXPORT void groove_player_position(struct GroovePlayer *player,
         struct GroovePlaylistItem **item, double *seconds);
 
 /// returns < 0 on error, 0 on no event ready, 1 on got event
 GROOVE_EXPORT int groove_player_event_get(struct GroovePlayer *player,
         union GroovePlayerEvent *event, int block);
+/// Like ::groove_player_event_get, but waits at most `seconds` for an event,
+/// returning 0 if the timeout expires first. See ::groove_sink_buffer_get_timeout.
+GROOVE_EXPORT int groove_player_event_get_timeout(struct GroovePlayer *player,
+        union GroovePlayerEvent *event, double seconds);
 /// returns < 0 on error, 0 on no event ready, 1 on event ready
 /// if block is 1, block until event is ready
 GROOVE_EXPORT int groove_player_event_peek(struct GroovePlayer *player, int block);
 
+/// Returns a file descriptor which is readable whenever
+/// ::groove_player_event_get would not block. See ::groove_sink_get_fd.
+GROOVE_EXPORT int groove_player_event_get_fd(struct GroovePlayer *player);
+
+/// Returns how many seconds of decoded audio the player is currently trying
+/// to keep queued ahead of the device, which only changes by itself with
+/// use_adaptive_buffering. Returns 0 until the device is first opened.
+GROOVE_EXPORT double groove_player_get_buffer_duration(struct GroovePlayer *player);
+
+/// Fills `stats` with the counters of the player's internal sink.
+/// See ::groove_sink_get_stats.
+GROOVE_EXPORT void groove_player_get_stats(struct GroovePlayer *player,
+        struct GrooveSinkStats *stats);
+
+struct GrooveExtraDeviceStats {
+    /// how much later than `device` this device plays the same audio, in
+    /// seconds, as last measured. Negative if it is ahead.
+    double offset_seconds;
+    /// how much faster than its nominal rate audio is being fed to this
+    /// device to keep it in time, as a fraction. 0.0001 is 100 ppm.
+    double rate_correction;
+    /// number of times it was too far out of time to resample and jumped
+    /// instead
+    int64_t resync_count;
+    /// number of times it ran out of audio, including whenever `device`
+    /// stops playing
+    int64_t underrun_count;
+};
+
+/// Fills `stats` with measurements of the virtual device, counted since
+/// you called ::groove_player_attach. Returns GrooveErrorInvalid unless the
+/// player was attached with use_virtual_device set.
+/// returns 0 on success, < 0 on error
+GROOVE_EXPORT int groove_player_get_virtual_device_stats(struct GroovePlayer *player,
+        struct GrooveVirtualDeviceStats *stats);
+
+/// Fills `stats` with measurements of `extra_devices[index]`, counted since
+/// you called ::groove_player_attach.
+/// returns 0 on success, < 0 on error
+GROOVE_EXPORT int groove_player_get_extra_device_stats(struct GroovePlayer *player,
+        int index, struct GrooveExtraDeviceStats *stats);
+
 /// wakes up a blocking call to groove_player_event_get or
 /// groove_player_event_peek with a GROOVE_EVENT_WAKEUP.
 GROOVE_EXPORT void groove_player_event_wakeup(struct GroovePlayer *player);
@@ -103,11 +258,17 @@ GROOVE_EXPORT void groove_player_event_wakeup(struct GroovePlayer *player);
 /// returns 0 on success, < 0 on error
 GROOVE_EXPORT int groove_player_set_gain(struct GroovePlayer *player, double gain);
 
-/// When you set the use_exact_audio_format field to 1, the audio device is
+/// Unless you set the use_fixed_format field to 1, the audio device is
 /// closed and re-opened as necessary. When this happens, a
-/// #GROOVE_EVENT_DEVICEREOPENED event is emitted, and you can use this function
+/// #GROOVE_EVENT_DEVICE_OPENED event is emitted, and you can use this function
 /// to discover the audio format of the device.
 GROOVE_EXPORT void groove_player_get_device_audio_format(struct GroovePlayer *player,
         struct GrooveAudioFormat *out_audio_format);
 
+/// Closes the audio device and opens it again in the same format, for
+/// example after a #GROOVE_EVENT_STREAM_ERROR. Playback continues where it
+/// left off once the device is open.
+/// returns 0 on success, < 0 on error
+GROOVE_EXPORT int groove_player_reopen_device(struct GroovePlayer *player);
+
 #endif
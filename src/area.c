@@ -0,0 +1,336 @@
+/*
+ * Copyright (c) 2015 Andrew Kelley
+ *
+ * This file is part of libgroove, which is MIT licensed.
+ * See http://opensource.org/licenses/MIT
+ */
+
+#include "area.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// true if the areas are one contiguous interleaved buffer starting at
+// areas[0].ptr, which is what most backends hand out
+static bool areas_interleaved(const struct SoundIoChannelArea *areas, int channel_count,
+        int bytes_per_sample)
+{
+    int bytes_per_frame = channel_count * bytes_per_sample;
+    for (int ch = 0; ch < channel_count; ch += 1) {
+        if (areas[ch].step != bytes_per_frame ||
+            areas[ch].ptr != areas[0].ptr + ch * bytes_per_sample)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// true if each channel's samples are contiguous
+static bool areas_planar(const struct SoundIoChannelArea *areas, int channel_count,
+        int bytes_per_sample)
+{
+    for (int ch = 0; ch < channel_count; ch += 1) {
+        if (areas[ch].step != bytes_per_sample)
+            return false;
+    }
+    return true;
+}
+
+static void advance_areas(struct SoundIoChannelArea *areas, int channel_count, int frame_count) {
+    for (int ch = 0; ch < channel_count; ch += 1)
+        areas[ch].ptr += areas[ch].step * frame_count;
+}
+
+static void interleave_stereo_16(uint16_t *dest, const uint16_t *left, const uint16_t *right,
+        int frame_count)
+{
+    int frame = 0;
+#ifdef __SSE2__
+    for (; frame + 8 <= frame_count; frame += 8) {
+        __m128i l = _mm_loadu_si128((const __m128i *)(left + frame));
+        __m128i r = _mm_loadu_si128((const __m128i *)(right + frame));
+        _mm_storeu_si128((__m128i *)(dest + frame * 2), _mm_unpacklo_epi16(l, r));
+        _mm_storeu_si128((__m128i *)(dest + frame * 2 + 8), _mm_unpackhi_epi16(l, r));
+    }
+#endif
+    for (; frame < frame_count; frame += 1) {
+        dest[frame * 2] = left[frame];
+        dest[frame * 2 + 1] = right[frame];
+    }
+}
+
+static void interleave_stereo_32(uint32_t *dest, const uint32_t *left, const uint32_t *right,
+        int frame_count)
+{
+    int frame = 0;
+#ifdef __SSE2__
+    for (; frame + 4 <= frame_count; frame += 4) {
+        __m128i l = _mm_loadu_si128((const __m128i *)(left + frame));
+        __m128i r = _mm_loadu_si128((const __m128i *)(right + frame));
+        _mm_storeu_si128((__m128i *)(dest + frame * 2), _mm_unpacklo_epi32(l, r));
+        _mm_storeu_si128((__m128i *)(dest + frame * 2 + 4), _mm_unpackhi_epi32(l, r));
+    }
+#endif
+    for (; frame < frame_count; frame += 1) {
+        dest[frame * 2] = left[frame];
+        dest[frame * 2 + 1] = right[frame];
+    }
+}
+
+static void deinterleave_stereo_16(uint16_t *left, uint16_t *right, const uint16_t *source,
+        int frame_count)
+{
+    int frame = 0;
+#ifdef __SSE2__
+    for (; frame + 8 <= frame_count; frame += 8) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(source + frame * 2));
+        __m128i b = _mm_loadu_si128((const __m128i *)(source + frame * 2 + 8));
+        // sign extend each half of every 32-bit frame, then pack them back
+        // down, which cannot saturate
+        __m128i l = _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(a, 16), 16),
+                _mm_srai_epi32(_mm_slli_epi32(b, 16), 16));
+        __m128i r = _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16));
+        _mm_storeu_si128((__m128i *)(left + frame), l);
+        _mm_storeu_si128((__m128i *)(right + frame), r);
+    }
+#endif
+    for (; frame < frame_count; frame += 1) {
+        left[frame] = source[frame * 2];
+        right[frame] = source[frame * 2 + 1];
+    }
+}
+
+static void deinterleave_stereo_32(uint32_t *left, uint32_t *right, const uint32_t *source,
+        int frame_count)
+{
+    int frame = 0;
+#ifdef __SSE2__
+    for (; frame + 4 <= frame_count; frame += 4) {
+        // shufps only moves bits around, so this is fine for integer samples
+        __m128 a = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(source + frame * 2)));
+        __m128 b = _mm_castsi128_ps(_mm_loadu_si128((const __m128i *)(source + frame * 2 + 4)));
+        __m128 l = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 r = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_si128((__m128i *)(left + frame), _mm_castps_si128(l));
+        _mm_storeu_si128((__m128i *)(right + frame), _mm_castps_si128(r));
+    }
+#endif
+    for (; frame < frame_count; frame += 1) {
+        left[frame] = source[frame * 2];
+        right[frame] = source[frame * 2 + 1];
+    }
+}
+
+static inline float clip_sample(float x) {
+    return (x > 1.0f) ? 1.0f : ((x < -1.0f) ? -1.0f : x);
+}
+
+// one channel at a time, so that the format is only looked at once
+#define CONVERT_LOOP(Type, expr) do { \
+    for (int frame = 0; frame < frame_count; frame += 1) { \
+        float x = source[frame * source_step] * gain; \
+        *(Type *)dest = (expr); \
+        dest += dest_step; \
+    } \
+} while (0)
+
+// a fixed sample size lets the compiler turn each sample copy into a move
+#define INTERLEAVE_LOOP(Type) do { \
+    Type *dest_samples = (Type *)dest; \
+    for (int frame = 0; frame < frame_count; frame += 1) { \
+        for (int ch = 0; ch < channel_count; ch += 1) \
+            *dest_samples++ = ((const Type *)planes[ch])[frame]; \
+    } \
+} while (0)
+
+#define DEINTERLEAVE_LOOP(Type) do { \
+    const Type *source_samples = (const Type *)source; \
+    for (int frame = 0; frame < frame_count; frame += 1) { \
+        for (int ch = 0; ch < channel_count; ch += 1) \
+            ((Type *)planes[ch])[frame] = *source_samples++; \
+    } \
+} while (0)
+
+static void interleave(uint8_t *dest, const uint8_t **planes, int channel_count,
+        int bytes_per_sample, int frame_count)
+{
+    if (channel_count == 2 && bytes_per_sample == 2) {
+        interleave_stereo_16((uint16_t *)dest, (const uint16_t *)planes[0],
+                (const uint16_t *)planes[1], frame_count);
+        return;
+    }
+    if (channel_count == 2 && bytes_per_sample == 4) {
+        interleave_stereo_32((uint32_t *)dest, (const uint32_t *)planes[0],
+                (const uint32_t *)planes[1], frame_count);
+        return;
+    }
+    switch (bytes_per_sample) {
+        case 1: INTERLEAVE_LOOP(uint8_t); break;
+        case 2: INTERLEAVE_LOOP(uint16_t); break;
+        case 4: INTERLEAVE_LOOP(uint32_t); break;
+        case 8: INTERLEAVE_LOOP(uint64_t); break;
+        default:
+            for (int frame = 0; frame < frame_count; frame += 1) {
+                for (int ch = 0; ch < channel_count; ch += 1) {
+                    memcpy(dest, planes[ch] + frame * bytes_per_sample, bytes_per_sample);
+                    dest += bytes_per_sample;
+                }
+            }
+    }
+}
+
+static void deinterleave(uint8_t **planes, const uint8_t *source, int channel_count,
+        int bytes_per_sample, int frame_count)
+{
+    if (channel_count == 2 && bytes_per_sample == 2) {
+        deinterleave_stereo_16((uint16_t *)planes[0], (uint16_t *)planes[1],
+                (const uint16_t *)source, frame_count);
+        return;
+    }
+    if (channel_count == 2 && bytes_per_sample == 4) {
+        deinterleave_stereo_32((uint32_t *)planes[0], (uint32_t *)planes[1],
+                (const uint32_t *)source, frame_count);
+        return;
+    }
+    switch (bytes_per_sample) {
+        case 1: DEINTERLEAVE_LOOP(uint8_t); break;
+        case 2: DEINTERLEAVE_LOOP(uint16_t); break;
+        case 4: DEINTERLEAVE_LOOP(uint32_t); break;
+        case 8: DEINTERLEAVE_LOOP(uint64_t); break;
+        default:
+            for (int frame = 0; frame < frame_count; frame += 1) {
+                for (int ch = 0; ch < channel_count; ch += 1) {
+                    memcpy(planes[ch] + frame * bytes_per_sample, source, bytes_per_sample);
+                    source += bytes_per_sample;
+                }
+            }
+    }
+}
+
+void groove_area_write_silence(struct SoundIoChannelArea *areas, int channel_count,
+        int bytes_per_sample, int frame_count)
+{
+    if (areas_interleaved(areas, channel_count, bytes_per_sample)) {
+        memset(areas[0].ptr, 0, frame_count * channel_count * bytes_per_sample);
+    } else if (areas_planar(areas, channel_count, bytes_per_sample)) {
+        for (int ch = 0; ch < channel_count; ch += 1)
+            memset(areas[ch].ptr, 0, frame_count * bytes_per_sample);
+    } else {
+        for (int frame = 0; frame < frame_count; frame += 1) {
+            for (int ch = 0; ch < channel_count; ch += 1) {
+                memset(areas[ch].ptr, 0, bytes_per_sample);
+                areas[ch].ptr += areas[ch].step;
+            }
+        }
+        return;
+    }
+    advance_areas(areas, channel_count, frame_count);
+}
+
+void groove_area_copy_planar(struct SoundIoChannelArea *areas, int channel_count,
+        int bytes_per_sample, uint8_t **data, int frame_index, int frame_count)
+{
+    int offset = frame_index * bytes_per_sample;
+    if (areas_planar(areas, channel_count, bytes_per_sample)) {
+        for (int ch = 0; ch < channel_count; ch += 1)
+            memcpy(areas[ch].ptr, data[ch] + offset, frame_count * bytes_per_sample);
+    } else if (areas_interleaved(areas, channel_count, bytes_per_sample)) {
+        const uint8_t *planes[SOUNDIO_MAX_CHANNELS];
+        for (int ch = 0; ch < channel_count; ch += 1)
+            planes[ch] = data[ch] + offset;
+        interleave((uint8_t *)areas[0].ptr, planes, channel_count, bytes_per_sample, frame_count);
+    } else {
+        int end_frame = frame_index + frame_count;
+        for (int frame = frame_index; frame < end_frame; frame += 1) {
+            for (int ch = 0; ch < channel_count; ch += 1) {
+                uint8_t *source = &data[ch][frame * bytes_per_sample];
+                memcpy(areas[ch].ptr, source, bytes_per_sample);
+                areas[ch].ptr += areas[ch].step;
+            }
+        }
+        return;
+    }
+    advance_areas(areas, channel_count, frame_count);
+}
+
+void groove_area_copy_interleaved(struct SoundIoChannelArea *areas, int channel_count,
+        int bytes_per_sample, const uint8_t *source, int frame_count)
+{
+    if (areas_interleaved(areas, channel_count, bytes_per_sample)) {
+        memcpy(areas[0].ptr, source, frame_count * channel_count * bytes_per_sample);
+    } else if (areas_planar(areas, channel_count, bytes_per_sample)) {
+        uint8_t *planes[SOUNDIO_MAX_CHANNELS];
+        for (int ch = 0; ch < channel_count; ch += 1)
+            planes[ch] = (uint8_t *)areas[ch].ptr;
+        deinterleave(planes, source, channel_count, bytes_per_sample, frame_count);
+    } else {
+        for (int frame = 0; frame < frame_count; frame += 1) {
+            for (int ch = 0; ch < channel_count; ch += 1) {
+                memcpy(areas[ch].ptr, source, bytes_per_sample);
+                areas[ch].ptr += areas[ch].step;
+                source += bytes_per_sample;
+            }
+        }
+        return;
+    }
+    advance_areas(areas, channel_count, frame_count);
+}
+
+void groove_area_convert_float(struct SoundIoChannelArea *areas, int channel_count,
+        enum SoundIoFormat format, uint8_t **data, bool is_planar, int frame_index,
+        int frame_count, float gain)
+{
+    // with nothing to convert, the plain copies are quicker
+    if (format == SoundIoFormatFloat32NE && gain == 1.0f) {
+        if (is_planar) {
+            groove_area_copy_planar(areas, channel_count, sizeof(float), data, frame_index,
+                    frame_count);
+        } else {
+            groove_area_copy_interleaved(areas, channel_count, sizeof(float),
+                    data[0] + frame_index * channel_count * sizeof(float), frame_count);
+        }
+        return;
+    }
+
+    for (int ch = 0; ch < channel_count; ch += 1) {
+        const float *source;
+        int source_step;
+        if (is_planar) {
+            source = (const float *)data[ch] + frame_index;
+            source_step = 1;
+        } else {
+            source = (const float *)data[0] + frame_index * channel_count + ch;
+            source_step = channel_count;
+        }
+        char *dest = areas[ch].ptr;
+        int dest_step = areas[ch].step;
+
+        switch (format) {
+            case SoundIoFormatFloat32NE:
+                CONVERT_LOOP(float, x);
+                break;
+            case SoundIoFormatFloat64NE:
+                CONVERT_LOOP(double, x);
+                break;
+            case SoundIoFormatS32NE:
+                CONVERT_LOOP(int32_t, (int32_t)lrint(clip_sample(x) * 2147483647.0));
+                break;
+            case SoundIoFormatS16NE:
+                CONVERT_LOOP(int16_t, (int16_t)lrintf(clip_sample(x) * 32767.0f));
+                break;
+            case SoundIoFormatU8:
+                CONVERT_LOOP(uint8_t, (uint8_t)lrintf(clip_sample(x) * 127.0f + 128.0f));
+                break;
+            default:
+                assert(0); // not a format the player opens devices with
+        }
+    }
+    advance_areas(areas, channel_count, frame_count);
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (c) 2015 Andrew Kelley
+ *
+ * This file is part of libgroove, which is MIT licensed.
+ * See http://opensource.org/licenses/MIT
+ */
+
+#ifndef GROOVE_AREA_H
+#define GROOVE_AREA_H
+
+#include <soundio/soundio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// These write frame_count frames into the channel areas of an output stream
+// and advance each areas[ch].ptr past what was written, the way the player's
+// audio callback fills the device buffer. When the areas form one interleaved
+// buffer or one contiguous buffer per channel, they copy in bulk instead of
+// a sample at a time.
+
+void groove_area_write_silence(struct SoundIoChannelArea *areas, int channel_count,
+        int bytes_per_sample, int frame_count);
+
+// data holds one plane per channel; copying starts at frame_index
+void groove_area_copy_planar(struct SoundIoChannelArea *areas, int channel_count,
+        int bytes_per_sample, uint8_t **data, int frame_index, int frame_count);
+
+// source points at the first interleaved frame to copy
+void groove_area_copy_interleaved(struct SoundIoChannelArea *areas, int channel_count,
+        int bytes_per_sample, const uint8_t *source, int frame_count);
+
+// data holds 32-bit float samples, one plane per channel if is_planar and
+// interleaved otherwise; converting starts at frame_index. Each sample is
+// multiplied by gain and, unless format is float, clipped. format must be
+// Float32NE, Float64NE, S32NE, S16NE or U8.
+void groove_area_convert_float(struct SoundIoChannelArea *areas, int channel_count,
+        enum SoundIoFormat format, uint8_t **data, bool is_planar, int frame_index,
+        int frame_count, float gain);
+
+#endif
@@ -17,6 +17,10 @@ struct GrooveAtomicLong {
     atomic_long x;
 };
 
+struct GrooveAtomicLongLong {
+    atomic_llong x;
+};
+
 struct GrooveAtomicInt {
     atomic_int x;
 };
@@ -25,9 +29,26 @@ struct GrooveAtomicBool {
     atomic_bool x;
 };
 
+struct GrooveAtomicPtr {
+    _Atomic(void *) x;
+};
+
+struct GrooveAtomicDouble {
+    _Atomic(double) x;
+};
+
 #define GROOVE_ATOMIC_LOAD(a) atomic_load(&a.x)
 #define GROOVE_ATOMIC_FETCH_ADD(a, delta) atomic_fetch_add(&a.x, delta)
 #define GROOVE_ATOMIC_STORE(a, value) atomic_store(&a.x, value)
 #define GROOVE_ATOMIC_EXCHANGE(a, value) atomic_exchange(&a.x, value)
+#define GROOVE_ATOMIC_FETCH_OR(a, bits) atomic_fetch_or(&a.x, bits)
+// on failure, expected is updated to the current value
+#define GROOVE_ATOMIC_COMPARE_EXCHANGE(a, expected, desired) \
+    atomic_compare_exchange_weak(&a.x, &expected, desired)
+
+// for statistics counters, which need no ordering with anything else
+#define GROOVE_ATOMIC_LOAD_RELAXED(a) atomic_load_explicit(&a.x, memory_order_relaxed)
+#define GROOVE_ATOMIC_FETCH_ADD_RELAXED(a, delta) atomic_fetch_add_explicit(&a.x, delta, memory_order_relaxed)
+#define GROOVE_ATOMIC_STORE_RELAXED(a, value) atomic_store_explicit(&a.x, value, memory_order_relaxed)
 
 #endif
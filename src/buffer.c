@@ -6,8 +6,46 @@
  */
 
 #include "buffer.h"
+#include "groove_private.h"
 #include "util.h"
 
+struct GrooveBufferAccount *groove_buffer_account_create(struct Groove *groove) {
+    struct GrooveBufferAccount *account = ALLOCATE(struct GrooveBufferAccount, 1);
+    if (!account)
+        return NULL;
+    account->groove = groove;
+    GROOVE_ATOMIC_STORE(account->used, 0);
+    GROOVE_ATOMIC_STORE(account->ref_count, 1);
+    return account;
+}
+
+void groove_buffer_account_unref(struct GrooveBufferAccount *account) {
+    if (!account)
+        return;
+    if (GROOVE_ATOMIC_FETCH_ADD(account->ref_count, -1) == 1)
+        DEALLOCATE(account);
+}
+
+void groove_buffer_charge(struct GrooveBuffer *buffer, struct GrooveBufferAccount *account) {
+    struct GrooveBufferPrivate *b = (struct GrooveBufferPrivate *) buffer;
+    assert(!b->account);
+    GROOVE_ATOMIC_FETCH_ADD(account->ref_count, 1);
+    GROOVE_ATOMIC_FETCH_ADD(account->used, buffer->size);
+    groove_budget_charge(account->groove, buffer->size);
+    b->account = account;
+}
+
+static void buffer_release_charge(struct GrooveBufferPrivate *b) {
+    struct GrooveBufferAccount *account = b->account;
+    if (!account)
+        return;
+    int size = b->externals.size;
+    GROOVE_ATOMIC_FETCH_ADD(account->used, -size);
+    groove_budget_release(account->groove, size);
+    groove_buffer_account_unref(account);
+    b->account = NULL;
+}
+
 void groove_buffer_ref(struct GrooveBuffer *buffer) {
     struct GrooveBufferPrivate *b = (struct GrooveBufferPrivate *) buffer;
 
@@ -28,6 +66,7 @@ void groove_buffer_unref(struct GrooveBuffer *buffer) {
     pthread_mutex_unlock(&b->mutex);
 
     if (is_free) {
+        buffer_release_charge(b);
         pthread_mutex_destroy(&b->mutex);
         if (b->is_packet && b->data) {
             DEALLOCATE(b->data);
@@ -9,16 +9,28 @@
 #define GROOVE_BUFFER_H
 
 #include "groove_internal.h"
+#include "atomics.h"
 
 #include <pthread.h>
 
 #include <libavutil/frame.h>
 
+// Bytes of decoded audio charged against the buffer budget on behalf of one
+// playlist. Buffers hold a reference so that the account outlives the
+// playlist which decoded them.
+struct GrooveBufferAccount {
+    struct Groove *groove;
+    struct GrooveAtomicLongLong used; // in bytes
+    struct GrooveAtomicInt ref_count;
+};
+
 struct GrooveBufferPrivate {
     struct GrooveBuffer externals;
     AVFrame *frame;
     int is_packet;
     int ref_count;
+    // the account which buffer->size was charged to, if any
+    struct GrooveBufferAccount *account;
 
     pthread_mutex_t mutex;
     // used for when is_packet is true
@@ -26,4 +38,11 @@ struct GrooveBufferPrivate {
     uint8_t *data;
 };
 
+struct GrooveBufferAccount *groove_buffer_account_create(struct Groove *groove);
+void groove_buffer_account_unref(struct GrooveBufferAccount *account);
+
+// Charge the size of the buffer to the account and its Groove until the
+// buffer is freed.
+void groove_buffer_charge(struct GrooveBuffer *buffer, struct GrooveBufferAccount *account);
+
 #endif
@@ -11,6 +11,8 @@
 #include "buffer.h"
 #include "util.h"
 #include "atomics.h"
+#include "trace.h"
+#include "probes.h"
 
 #include <string.h>
 #include <pthread.h>
@@ -30,9 +32,6 @@ struct GrooveEncoderPrivate {
     int audioq_size; // in bytes
     struct GrooveAtomicBool abort_request;
 
-    // set temporarily
-    struct GroovePlaylistItem *purge_item;
-
     // encode_head_mutex applies to variables inside this block.
     pthread_mutex_t encode_head_mutex;
     char encode_head_mutex_inited;
@@ -129,6 +128,7 @@ static int encode_buffer(struct GrooveEncoder *encoder, struct GrooveBuffer *buf
     if (!got_packet)
         return GrooveErrorEncoding;
 
+    GROOVE_PROBE3(encoder_write_packet, encoder, e->pkt.size, e->pkt.pts);
     av_write_frame(e->fmt_ctx, &e->pkt);
     av_packet_unref(&e->pkt);
 
@@ -192,6 +192,9 @@ static void *encode_thread(void *arg) {
     struct GrooveEncoderPrivate *e = (struct GrooveEncoderPrivate *) encoder;
 
     struct GrooveBuffer *buffer;
+
+    groove_trace_thread_name("encoder");
+
     while (!GROOVE_ATOMIC_LOAD(e->abort_request)) {
         pthread_mutex_lock(&e->encode_head_mutex);
 
@@ -212,7 +215,9 @@ static void *encode_thread(void *arg) {
 
         if (result == GROOVE_BUFFER_END) {
             // flush encoder with empty packets
+            GROOVE_TRACE_BEGIN("encode_buffer");
             while (encode_buffer(encoder, NULL) >= 0) {}
+            GROOVE_TRACE_END("encode_buffer");
             // then flush format context with empty packets
             while (av_write_frame(e->fmt_ctx, NULL) == 0) {}
 
@@ -256,7 +261,9 @@ static void *encode_thread(void *arg) {
             e->sent_header = 1;
         }
 
+        GROOVE_TRACE_BEGIN("encode_buffer");
         encode_buffer(encoder, buffer);
+        GROOVE_TRACE_END("encode_buffer");
         pthread_mutex_unlock(&e->encode_head_mutex);
         groove_buffer_unref(buffer);
     }
@@ -268,9 +275,7 @@ static void sink_purge(struct GrooveSink *sink, struct GroovePlaylistItem *item)
     struct GrooveEncoderPrivate *e = (struct GrooveEncoderPrivate *) encoder;
 
     pthread_mutex_lock(&e->encode_head_mutex);
-    e->purge_item = item;
-    groove_queue_purge(e->audioq);
-    e->purge_item = NULL;
+    groove_queue_purge(e->audioq, item);
 
     if (e->encode_head == item) {
         e->encode_head = NULL;
@@ -295,12 +300,16 @@ static void sink_flush(struct GrooveSink *sink) {
     pthread_mutex_unlock(&e->encode_head_mutex);
 }
 
-static int audioq_purge(struct GrooveQueue* queue, void *obj) {
+static void *audioq_group(struct GrooveQueue* queue, void *obj) {
     struct GrooveBuffer *buffer = (struct GrooveBuffer *)obj;
     if (buffer == end_of_q_sentinel)
-        return 0;
-    struct GrooveEncoderPrivate *e = (struct GrooveEncoderPrivate *)queue->context;
-    return buffer->item == e->purge_item;
+        return NULL;
+    return buffer->item;
+}
+
+static int audioq_obj_size(struct GrooveQueue* queue, void *obj) {
+    struct GrooveBuffer *buffer = (struct GrooveBuffer *)obj;
+    return (buffer == end_of_q_sentinel) ? 0 : buffer->size;
 }
 
 static void audioq_cleanup(struct GrooveQueue* queue, void *obj) {
@@ -425,7 +434,8 @@ struct GrooveEncoder *groove_encoder_create(struct Groove *groove) {
     e->audioq->cleanup = audioq_cleanup;
     e->audioq->put = audioq_put;
     e->audioq->get = audioq_get;
-    e->audioq->purge = audioq_purge;
+    e->audioq->group = audioq_group;
+    e->audioq->size = audioq_obj_size;
 
     e->sink = groove_sink_create(groove);
     if (!e->sink) {
@@ -719,10 +729,16 @@ int groove_encoder_detach(struct GrooveEncoder *encoder) {
 
 int groove_encoder_buffer_get(struct GrooveEncoder *encoder,
         struct GrooveBuffer **buffer, int block)
+{
+    return groove_encoder_buffer_get_timeout(encoder, buffer, block ? -1.0 : 0.0);
+}
+
+int groove_encoder_buffer_get_timeout(struct GrooveEncoder *encoder,
+        struct GrooveBuffer **buffer, double seconds)
 {
     struct GrooveEncoderPrivate *e = (struct GrooveEncoderPrivate *) encoder;
 
-    if (groove_queue_get(e->audioq, (void**)buffer, block) == 1) {
+    if (groove_queue_get_timeout(e->audioq, (void**)buffer, seconds) == 1) {
         if (*buffer == end_of_q_sentinel) {
             *buffer = NULL;
             return GROOVE_BUFFER_END;
@@ -750,6 +766,21 @@ int groove_encoder_metadata_set(struct GrooveEncoder *encoder, const char *key,
     return av_dict_set(&e->metadata, key, value, flags|AV_DICT_IGNORE_SUFFIX);
 }
 
+void groove_encoder_get_stats(struct GrooveEncoder *encoder,
+        struct GrooveSinkStats *sink_stats, struct GrooveQueueStats *queue_stats)
+{
+    struct GrooveEncoderPrivate *e = (struct GrooveEncoderPrivate *) encoder;
+    if (sink_stats)
+        groove_sink_get_stats(e->sink, sink_stats);
+    if (queue_stats)
+        groove_queue_get_stats(e->audioq, queue_stats);
+}
+
+int groove_encoder_get_fd(struct GrooveEncoder *encoder) {
+    struct GrooveEncoderPrivate *e = (struct GrooveEncoderPrivate *) encoder;
+    return groove_queue_get_fd(e->audioq);
+}
+
 int groove_encoder_buffer_peek(struct GrooveEncoder *encoder, int block) {
     struct GrooveEncoderPrivate *e = (struct GrooveEncoderPrivate *) encoder;
     return groove_queue_peek(e->audioq, block);
@@ -10,6 +10,7 @@
 #include "queue.h"
 #include "util.h"
 #include "atomics.h"
+#include "trace.h"
 
 #include <chromaprint.h>
 
@@ -45,9 +46,6 @@ struct GrooveFingerprinterPrivate {
 
     ChromaprintContext *chroma_ctx;
 
-    // set temporarily
-    struct GroovePlaylistItem *purge_item;
-
     struct GrooveAtomicBool abort_request;
 };
 
@@ -80,6 +78,9 @@ static void *print_thread(void *arg) {
     struct GrooveFingerprinter *printer = &p->externals;
 
     struct GrooveBuffer *buffer;
+
+    groove_trace_thread_name("fingerprinter");
+
     while (!GROOVE_ATOMIC_LOAD(p->abort_request)) {
         pthread_mutex_lock(&p->info_head_mutex);
 
@@ -100,7 +101,9 @@ static void *print_thread(void *arg) {
 
         if (result == GROOVE_BUFFER_END) {
             // last file info
+            GROOVE_TRACE_BEGIN("emit_track_info");
             emit_track_info(p);
+            GROOVE_TRACE_END("emit_track_info");
 
             // send album info
             struct GrooveFingerprinterInfo *info = ALLOCATE(struct GrooveFingerprinterInfo, 1);
@@ -127,7 +130,9 @@ static void *print_thread(void *arg) {
 
         if (buffer->item != p->info_head) {
             if (p->info_head) {
+                GROOVE_TRACE_BEGIN("emit_track_info");
                 emit_track_info(p);
+                GROOVE_TRACE_END("emit_track_info");
             }
             if (!chromaprint_start(p->chroma_ctx, 44100, 2)) {
                 av_log(NULL, AV_LOG_ERROR, "unable to start fingerprint\n");
@@ -173,20 +178,16 @@ static void info_queue_get(struct GrooveQueue *queue, void *obj) {
         pthread_cond_signal(&p->drain_cond);
 }
 
-static int info_queue_purge(struct GrooveQueue* queue, void *obj) {
+static void *info_queue_group(struct GrooveQueue* queue, void *obj) {
     struct GrooveFingerprinterInfo *info = (struct GrooveFingerprinterInfo *)obj;
-    struct GrooveFingerprinterPrivate *p = (struct GrooveFingerprinterPrivate *)queue->context;
-
-    return info->item == p->purge_item;
+    return info->item;
 }
 
 static void sink_purge(struct GrooveSink *sink, struct GroovePlaylistItem *item) {
     struct GrooveFingerprinterPrivate *p = (struct GrooveFingerprinterPrivate *)sink->userdata;
 
     pthread_mutex_lock(&p->info_head_mutex);
-    p->purge_item = item;
-    groove_queue_purge(p->info_queue);
-    p->purge_item = NULL;
+    groove_queue_purge(p->info_queue, item);
 
     if (p->info_head == item) {
         p->info_head = NULL;
@@ -244,7 +245,7 @@ struct GrooveFingerprinter *groove_fingerprinter_create(struct Groove *groove) {
     p->info_queue->cleanup = info_queue_cleanup;
     p->info_queue->put = info_queue_put;
     p->info_queue->get = info_queue_get;
-    p->info_queue->purge = info_queue_purge;
+    p->info_queue->group = info_queue_group;
 
     p->sink = groove_sink_create(groove);
     if (!p->sink) {
@@ -347,11 +348,17 @@ int groove_fingerprinter_detach(struct GrooveFingerprinter *printer) {
 
 int groove_fingerprinter_info_get(struct GrooveFingerprinter *printer,
         struct GrooveFingerprinterInfo *info, int block)
+{
+    return groove_fingerprinter_info_get_timeout(printer, info, block ? -1.0 : 0.0);
+}
+
+int groove_fingerprinter_info_get_timeout(struct GrooveFingerprinter *printer,
+        struct GrooveFingerprinterInfo *info, double seconds)
 {
     struct GrooveFingerprinterPrivate *p = (struct GrooveFingerprinterPrivate *) printer;
 
     struct GrooveFingerprinterInfo *info_ptr;
-    if (groove_queue_get(p->info_queue, (void**)&info_ptr, block) == 1) {
+    if (groove_queue_get_timeout(p->info_queue, (void**)&info_ptr, seconds) == 1) {
         *info = *info_ptr;
         DEALLOCATE(info_ptr);
         return 1;
@@ -360,6 +367,18 @@ int groove_fingerprinter_info_get(struct GrooveFingerprinter *printer,
     return 0;
 }
 
+int groove_fingerprinter_get_fd(struct GrooveFingerprinter *printer) {
+    struct GrooveFingerprinterPrivate *p = (struct GrooveFingerprinterPrivate *) printer;
+    return groove_queue_get_fd(p->info_queue);
+}
+
+void groove_fingerprinter_get_stats(struct GrooveFingerprinter *printer,
+        struct GrooveSinkStats *stats)
+{
+    struct GrooveFingerprinterPrivate *p = (struct GrooveFingerprinterPrivate *) printer;
+    groove_sink_get_stats(p->sink, stats);
+}
+
 int groove_fingerprinter_info_peek(struct GrooveFingerprinter *printer,
         int block)
 {
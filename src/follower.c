@@ -0,0 +1,468 @@
+/*
+ * Copyright (c) 2015 Andrew Kelley
+ *
+ * This file is part of libgroove, which is MIT licensed.
+ * See http://opensource.org/licenses/MIT
+ */
+
+#include "follower.h"
+#include "groove_internal.h"
+#include "atomics.h"
+#include "util.h"
+#include "os.h"
+
+#include <string.h>
+#include <math.h>
+
+// further out of time than this and the follower jumps instead of resampling
+#define RESYNC_SECONDS 0.015
+// how long it takes a change in the measured offset to fully count
+#define SMOOTH_SECONDS 1.0
+// the offset is corrected at a rate which would remove it in this long
+#define CORRECTION_SECONDS 2.0
+// largest change in playback rate. 0.002 is about 3.5 cents, which is not
+// audible as a change in pitch.
+#define MAX_CORRECTION 0.002
+
+struct GrooveFollower {
+    struct SoundIoOutStream *outstream;
+    enum SoundIoFormat source_format;
+    int source_rate;
+    int source_bytes_per_sample;
+    int source_bytes_per_frame;
+    int channel_count;
+    void (*error_callback)(void *userdata, int err);
+    void *userdata;
+
+    // frames from the player's audio callback, which is the only writer.
+    // this follower's callback is the only reader.
+    uint8_t *ring;
+    long ring_capacity; // in frames
+    struct GrooveAtomicLong ring_head; // frames ever written
+    struct GrooveAtomicLong ring_tail; // frames ever read
+
+    // when the player's callback last ran and how long until the last frame
+    // it wrote is heard. odd while it is being written.
+    struct GrooveAtomicLong sync_seq;
+    struct GrooveAtomicDouble sync_time;
+    struct GrooveAtomicDouble sync_latency;
+    struct GrooveAtomicLong sync_head;
+
+    // owned by this follower's callback. output is interpolated between the
+    // source frames prev and next, which are ring_tail - 2 and ring_tail - 1.
+    float prev[SOUNDIO_MAX_CHANNELS];
+    float next[SOUNDIO_MAX_CHANNELS];
+    bool primed;
+    double frac;
+    double nominal_ratio;
+    // source frames consumed per device frame
+    double ratio;
+    // ring position of the last frame written to the device
+    double last_pos;
+    double filtered_offset;
+    // source frames to drop, either to catch up or to make up for silence
+    // played while the ring was dry
+    double skip_frames;
+    bool dry;
+    int silence_frames_left;
+
+    struct GrooveAtomicDouble offset;
+    struct GrooveAtomicDouble correction;
+    struct GrooveAtomicLongLong resync_count;
+    struct GrooveAtomicLongLong underrun_count;
+};
+
+static bool format_supported(enum SoundIoFormat format) {
+    switch (format) {
+        case SoundIoFormatFloat32NE:
+        case SoundIoFormatFloat64NE:
+        case SoundIoFormatS32NE:
+        case SoundIoFormatS16NE:
+        case SoundIoFormatU8:
+            return true;
+        default:
+            return false;
+    }
+}
+
+static float read_sample(enum SoundIoFormat format, const uint8_t *ptr) {
+    switch (format) {
+        case SoundIoFormatFloat32NE: {
+            float x;
+            memcpy(&x, ptr, sizeof(x));
+            return x;
+        }
+        case SoundIoFormatFloat64NE: {
+            double x;
+            memcpy(&x, ptr, sizeof(x));
+            return (float)x;
+        }
+        case SoundIoFormatS32NE: {
+            int32_t x;
+            memcpy(&x, ptr, sizeof(x));
+            return (float)(x / 2147483648.0);
+        }
+        case SoundIoFormatS16NE: {
+            int16_t x;
+            memcpy(&x, ptr, sizeof(x));
+            return x / 32768.0f;
+        }
+        case SoundIoFormatU8:
+            return (*ptr - 128) / 128.0f;
+        default:
+            return 0.0f;
+    }
+}
+
+static void write_sample(enum SoundIoFormat format, char *ptr, float x) {
+    x = (x > 1.0f) ? 1.0f : ((x < -1.0f) ? -1.0f : x);
+    switch (format) {
+        case SoundIoFormatFloat32NE:
+            memcpy(ptr, &x, sizeof(x));
+            break;
+        case SoundIoFormatFloat64NE: {
+            double d = x;
+            memcpy(ptr, &d, sizeof(d));
+            break;
+        }
+        case SoundIoFormatS32NE: {
+            int32_t s = (int32_t)lrint(x * 2147483647.0);
+            memcpy(ptr, &s, sizeof(s));
+            break;
+        }
+        case SoundIoFormatS16NE: {
+            int16_t s = (int16_t)lrintf(x * 32767.0f);
+            memcpy(ptr, &s, sizeof(s));
+            break;
+        }
+        case SoundIoFormatU8:
+            *(uint8_t *)ptr = (uint8_t)lrintf(x * 127.0f + 128.0f);
+            break;
+        default:
+            break;
+    }
+}
+
+static void pop_frame(struct GrooveFollower *f, long *tail, float *frame) {
+    const uint8_t *ptr = f->ring + (*tail % f->ring_capacity) * f->source_bytes_per_frame;
+    for (int ch = 0; ch < f->channel_count; ch += 1)
+        frame[ch] = read_sample(f->source_format, ptr + ch * f->source_bytes_per_sample);
+    *tail += 1;
+}
+
+// linear interpolation. returns false if the ring has run dry.
+static bool next_frame(struct GrooveFollower *f, long *tail, long head, float *out) {
+    if (!f->primed) {
+        if (*tail == head)
+            return false;
+        pop_frame(f, tail, f->next);
+        memcpy(f->prev, f->next, sizeof(f->prev));
+        f->primed = true;
+        f->frac = 0.0;
+    }
+    while (f->frac >= 1.0) {
+        if (*tail == head)
+            return false;
+        memcpy(f->prev, f->next, sizeof(f->prev));
+        pop_frame(f, tail, f->next);
+        f->frac -= 1.0;
+    }
+    for (int ch = 0; ch < f->channel_count; ch += 1)
+        out[ch] = f->prev[ch] + (f->next[ch] - f->prev[ch]) * (float)f->frac;
+    f->last_pos = (*tail - 2) + f->frac;
+    f->frac += f->ratio;
+    return true;
+}
+
+static bool read_sync(struct GrooveFollower *f, double *time, double *latency, long *head) {
+    // the writer is another audio callback and never stalls for long, but
+    // this is one too, so it gives up rather than spin
+    for (int attempt = 0; attempt < 4; attempt += 1) {
+        long seq = GROOVE_ATOMIC_LOAD(f->sync_seq);
+        if (seq & 1)
+            continue;
+        *time = GROOVE_ATOMIC_LOAD_RELAXED(f->sync_time);
+        *latency = GROOVE_ATOMIC_LOAD_RELAXED(f->sync_latency);
+        *head = GROOVE_ATOMIC_LOAD_RELAXED(f->sync_head);
+        atomic_thread_fence(memory_order_acquire);
+        if (GROOVE_ATOMIC_LOAD_RELAXED(f->sync_seq) == seq)
+            return seq != 0;
+    }
+    return false;
+}
+
+// compares when the frame at last_pos will be heard from this device with
+// when it will be heard from the player's, and adjusts the playback rate to
+// close the gap
+static void update_rate(struct GrooveFollower *f, double seconds_written) {
+    double source_time, source_latency;
+    long source_head;
+    if (!read_sync(f, &source_time, &source_latency, &source_head))
+        return;
+
+    double latency;
+    if (soundio_outstream_get_latency(f->outstream, &latency))
+        return;
+
+    double heard_here = groove_os_get_time() + latency;
+    double heard_there = source_time + source_latency -
+        (source_head - 1 - f->last_pos) / f->source_rate;
+    double offset = heard_here - heard_there;
+
+    if (fabs(offset) > RESYNC_SECONDS) {
+        if (offset > 0.0)
+            f->skip_frames = offset * f->source_rate;
+        else
+            f->silence_frames_left = (int)(-offset * f->outstream->sample_rate);
+        f->filtered_offset = 0.0;
+        f->ratio = f->nominal_ratio;
+        GROOVE_ATOMIC_FETCH_ADD_RELAXED(f->resync_count, 1);
+    } else {
+        f->filtered_offset += (offset - f->filtered_offset) *
+            seconds_written / (SMOOTH_SECONDS + seconds_written);
+        double correction = f->filtered_offset / CORRECTION_SECONDS;
+        correction = groove_max_double(groove_min_double(correction, MAX_CORRECTION),
+                -MAX_CORRECTION);
+        f->ratio = f->nominal_ratio * (1.0 + correction);
+    }
+
+    GROOVE_ATOMIC_STORE_RELAXED(f->offset, offset);
+    GROOVE_ATOMIC_STORE_RELAXED(f->correction, f->ratio / f->nominal_ratio - 1.0);
+}
+
+static void write_callback(struct SoundIoOutStream *outstream,
+        int frame_count_min, int frame_count_max)
+{
+    struct GrooveFollower *f = (struct GrooveFollower *)outstream->userdata;
+    struct SoundIoChannelArea *areas;
+    float frame[SOUNDIO_MAX_CHANNELS];
+    int err;
+
+    long head = GROOVE_ATOMIC_LOAD(f->ring_head);
+    long tail = GROOVE_ATOMIC_LOAD_RELAXED(f->ring_tail);
+
+    long skip = groove_min_long((long)f->skip_frames, head - tail);
+    if (skip > 0) {
+        tail += skip;
+        f->skip_frames -= skip;
+        f->primed = false;
+    }
+
+    // only write what the ring can supply, unless the device would run dry.
+    // padding with silence would leave the audio behind it playing late.
+    double source_frames = (head - tail) + (f->primed ? 1.0 - f->frac : 0.0);
+    long can_write = f->silence_frames_left + (long)(source_frames / f->ratio);
+    int frame_count_target = groove_min_long(frame_count_max,
+            groove_max_long(frame_count_min, can_write));
+
+    bool ran_dry = false;
+    bool last_was_audio = false;
+    int frames_left = frame_count_target;
+    while (frames_left > 0) {
+        int frame_count = frames_left;
+        if ((err = soundio_outstream_begin_write(outstream, &areas, &frame_count))) {
+            f->error_callback(f->userdata, err);
+            break;
+        }
+        if (!frame_count)
+            break;
+
+        for (int i = 0; i < frame_count; i += 1) {
+            if (f->silence_frames_left > 0) {
+                f->silence_frames_left -= 1;
+                memset(frame, 0, sizeof(frame));
+                last_was_audio = false;
+            } else if (next_frame(f, &tail, head, frame)) {
+                last_was_audio = true;
+                f->dry = false;
+            } else {
+                // count running dry once, rather than every callback until
+                // audio comes back
+                if (f->primed) {
+                    ran_dry = true;
+                    f->dry = true;
+                    f->primed = false;
+                }
+                // a short gap is skipped over when the audio arrives, so
+                // what follows stays in time. a long one means the player's
+                // device stopped and there is nothing to catch up on.
+                if (f->dry) {
+                    f->skip_frames += f->ratio;
+                    if (f->skip_frames > RESYNC_SECONDS * f->source_rate) {
+                        f->skip_frames = 0.0;
+                        f->dry = false;
+                    }
+                }
+                memset(frame, 0, sizeof(frame));
+                last_was_audio = false;
+            }
+            for (int ch = 0; ch < f->channel_count; ch += 1) {
+                write_sample(outstream->format, areas[ch].ptr, frame[ch]);
+                areas[ch].ptr += areas[ch].step;
+            }
+        }
+        frames_left -= frame_count;
+
+        if ((err = soundio_outstream_end_write(outstream))) {
+            if (err == SoundIoErrorUnderflow)
+                GROOVE_ATOMIC_FETCH_ADD_RELAXED(f->underrun_count, 1);
+            else
+                f->error_callback(f->userdata, err);
+            break;
+        }
+    }
+
+    GROOVE_ATOMIC_STORE(f->ring_tail, tail);
+
+    if (ran_dry)
+        GROOVE_ATOMIC_FETCH_ADD_RELAXED(f->underrun_count, 1);
+    // the offset only means something if the device's newest frame is audio
+    if (last_was_audio)
+        update_rate(f, (frame_count_target - frames_left) / (double)outstream->sample_rate);
+}
+
+static void underflow_callback(struct SoundIoOutStream *outstream) {
+    struct GrooveFollower *f = (struct GrooveFollower *)outstream->userdata;
+    GROOVE_ATOMIC_FETCH_ADD_RELAXED(f->underrun_count, 1);
+}
+
+static void error_callback(struct SoundIoOutStream *outstream, int err) {
+    struct GrooveFollower *f = (struct GrooveFollower *)outstream->userdata;
+    av_log(NULL, AV_LOG_ERROR, "extra device stream error: %s\n", soundio_strerror(err));
+    f->error_callback(f->userdata, err);
+}
+
+int groove_follower_create(struct SoundIoDevice *device,
+        const struct GrooveAudioFormat *source_format,
+        const struct GrooveAudioFormat *device_format,
+        double latency, double ring_seconds,
+        void (*error_callback_fn)(void *userdata, int err), void *userdata,
+        struct GrooveFollower **out_follower)
+{
+    int err;
+
+    if (source_format->is_planar || !format_supported(source_format->format) ||
+        !format_supported(device_format->format) ||
+        source_format->layout.channel_count != device_format->layout.channel_count)
+    {
+        return GrooveErrorDeviceParams;
+    }
+
+    struct GrooveFollower *f = ALLOCATE(struct GrooveFollower, 1);
+    if (!f)
+        return GrooveErrorNoMem;
+
+    f->source_format = source_format->format;
+    f->source_rate = source_format->sample_rate;
+    f->source_bytes_per_sample = soundio_get_bytes_per_sample(source_format->format);
+    f->channel_count = source_format->layout.channel_count;
+    f->source_bytes_per_frame = f->source_bytes_per_sample * f->channel_count;
+    f->error_callback = error_callback_fn;
+    f->userdata = userdata;
+    f->nominal_ratio = source_format->sample_rate / (double)device_format->sample_rate;
+    f->ratio = f->nominal_ratio;
+
+    f->ring_capacity = groove_max_long(ceil(ring_seconds * f->source_rate), 1);
+    f->ring = ALLOCATE_NONZERO(uint8_t, f->ring_capacity * f->source_bytes_per_frame);
+    if (!f->ring) {
+        groove_follower_destroy(f);
+        return GrooveErrorNoMem;
+    }
+
+    f->outstream = soundio_outstream_create(device);
+    if (!f->outstream) {
+        groove_follower_destroy(f);
+        return GrooveErrorNoMem;
+    }
+    f->outstream->format = device_format->format;
+    f->outstream->sample_rate = device_format->sample_rate;
+    f->outstream->layout = device_format->layout;
+    f->outstream->software_latency = latency;
+    f->outstream->userdata = f;
+    f->outstream->write_callback = write_callback;
+    f->outstream->underflow_callback = underflow_callback;
+    f->outstream->error_callback = error_callback;
+
+    if ((err = soundio_outstream_open(f->outstream))) {
+        av_log(NULL, AV_LOG_ERROR, "unable to open extra device: %s\n", soundio_strerror(err));
+        groove_follower_destroy(f);
+        return GrooveErrorOpeningDevice;
+    }
+
+    *out_follower = f;
+    return 0;
+}
+
+void groove_follower_destroy(struct GrooveFollower *f) {
+    if (!f)
+        return;
+    soundio_outstream_destroy(f->outstream);
+    DEALLOCATE(f->ring);
+    DEALLOCATE(f);
+}
+
+int groove_follower_start(struct GrooveFollower *f) {
+    int err;
+    if ((err = soundio_outstream_start(f->outstream))) {
+        av_log(NULL, AV_LOG_ERROR, "unable to start extra device: %s\n", soundio_strerror(err));
+        return GrooveErrorOpeningDevice;
+    }
+    return 0;
+}
+
+// returns where to write up to frame_count frames, and how many fit before
+// the ring wraps or fills. frames which do not fit are dropped; the
+// follower notices the gap and jumps over it.
+static int ring_space(struct GrooveFollower *f, long head, int frame_count, uint8_t **ptr) {
+    long used = head - GROOVE_ATOMIC_LOAD(f->ring_tail);
+    long index = head % f->ring_capacity;
+    long contiguous = groove_min_long(f->ring_capacity - used, f->ring_capacity - index);
+    *ptr = f->ring + index * f->source_bytes_per_frame;
+    return groove_min_long(frame_count, contiguous);
+}
+
+void groove_follower_write(struct GrooveFollower *f, const uint8_t *frames, int frame_count) {
+    long head = GROOVE_ATOMIC_LOAD_RELAXED(f->ring_head);
+    while (frame_count > 0) {
+        uint8_t *dest;
+        int count = ring_space(f, head, frame_count, &dest);
+        if (count <= 0)
+            break;
+        memcpy(dest, frames, count * f->source_bytes_per_frame);
+        frames += count * f->source_bytes_per_frame;
+        frame_count -= count;
+        head += count;
+    }
+    GROOVE_ATOMIC_STORE(f->ring_head, head);
+}
+
+void groove_follower_write_silence(struct GrooveFollower *f, int frame_count) {
+    long head = GROOVE_ATOMIC_LOAD_RELAXED(f->ring_head);
+    while (frame_count > 0) {
+        uint8_t *dest;
+        int count = ring_space(f, head, frame_count, &dest);
+        if (count <= 0)
+            break;
+        memset(dest, 0, count * f->source_bytes_per_frame);
+        frame_count -= count;
+        head += count;
+    }
+    GROOVE_ATOMIC_STORE(f->ring_head, head);
+}
+
+void groove_follower_sync(struct GrooveFollower *f, double time, double latency) {
+    long seq = GROOVE_ATOMIC_LOAD_RELAXED(f->sync_seq);
+    GROOVE_ATOMIC_STORE_RELAXED(f->sync_seq, seq + 1);
+    atomic_thread_fence(memory_order_release);
+    GROOVE_ATOMIC_STORE_RELAXED(f->sync_time, time);
+    GROOVE_ATOMIC_STORE_RELAXED(f->sync_latency, latency);
+    GROOVE_ATOMIC_STORE_RELAXED(f->sync_head, GROOVE_ATOMIC_LOAD_RELAXED(f->ring_head));
+    GROOVE_ATOMIC_STORE(f->sync_seq, seq + 2);
+}
+
+void groove_follower_get_stats(struct GrooveFollower *f, struct GrooveExtraDeviceStats *stats) {
+    stats->offset_seconds = GROOVE_ATOMIC_LOAD_RELAXED(f->offset);
+    stats->rate_correction = GROOVE_ATOMIC_LOAD_RELAXED(f->correction);
+    stats->resync_count = GROOVE_ATOMIC_LOAD_RELAXED(f->resync_count);
+    stats->underrun_count = GROOVE_ATOMIC_LOAD_RELAXED(f->underrun_count);
+}
@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2015 Andrew Kelley
+ *
+ * This file is part of libgroove, which is MIT licensed.
+ * See http://opensource.org/licenses/MIT
+ */
+
+#ifndef GROOVE_FOLLOWER_H
+#define GROOVE_FOLLOWER_H
+
+#include "groove/player.h"
+
+#include <soundio/soundio.h>
+
+// An extra output device which plays whatever the player's own device plays.
+// The player's audio callback copies each frame it writes into the
+// follower's ring, and the follower's callback reads it back out, resampled
+// by a fraction of a percent so that its device stays in time with the
+// player's despite their clocks running at slightly different rates.
+
+struct GrooveFollower;
+
+// source_format is what the player's device plays, and must be interleaved.
+// device_format is what to open this device with; it may differ in sample
+// rate and sample format, but not in layout.
+int groove_follower_create(struct SoundIoDevice *device,
+        const struct GrooveAudioFormat *source_format,
+        const struct GrooveAudioFormat *device_format,
+        double latency, double ring_seconds,
+        void (*error_callback)(void *userdata, int err), void *userdata,
+        struct GrooveFollower **out_follower);
+void groove_follower_destroy(struct GrooveFollower *follower);
+
+int groove_follower_start(struct GrooveFollower *follower);
+
+// the player's audio callback only. write and write_silence hand over the
+// frames just written to the player's device, and sync says when that was
+// and how long until the last of them is heard.
+void groove_follower_write(struct GrooveFollower *follower, const uint8_t *frames,
+        int frame_count);
+void groove_follower_write_silence(struct GrooveFollower *follower, int frame_count);
+void groove_follower_sync(struct GrooveFollower *follower, double time, double latency);
+
+void groove_follower_get_stats(struct GrooveFollower *follower,
+        struct GrooveExtraDeviceStats *stats);
+
+#endif
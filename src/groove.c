@@ -42,6 +42,7 @@ const char *groove_strerror(int error) {
         case GrooveErrorEncoderNotFound: return "encoder not found";
         case GrooveErrorOpeningDevice: return "unable to open device";
         case GrooveErrorDeviceParams: return "device parameters not supported";
+        case GrooveErrorUnsupported: return "operation not supported on this platform";
     }
     return "(invalid error)";
 }
@@ -99,14 +100,89 @@ int groove_create(struct Groove **out_groove) {
         return err;
     }
 
+    if (pthread_mutex_init(&groove->budget_mutex, NULL)) {
+        groove_destroy(groove);
+        return GrooveErrorSystemResources;
+    }
+    groove->budget_mutex_inited = true;
+
+    if (pthread_cond_init(&groove->budget_cond, NULL)) {
+        groove_destroy(groove);
+        return GrooveErrorSystemResources;
+    }
+    groove->budget_cond_inited = true;
+
+    GROOVE_ATOMIC_STORE(groove->budget_limit, 0);
+    GROOVE_ATOMIC_STORE(groove->budget_used, 0);
+    GROOVE_ATOMIC_STORE(groove->budget_wake_count, 0);
+
     *out_groove = groove;
     return 0;
 }
 
 void groove_destroy(struct Groove *groove) {
+    if (!groove)
+        return;
+
+    if (groove->budget_cond_inited)
+        pthread_cond_destroy(&groove->budget_cond);
+    if (groove->budget_mutex_inited)
+        pthread_mutex_destroy(&groove->budget_mutex);
+
     DEALLOCATE(groove);
 }
 
+void groove_set_buffer_budget(struct Groove *groove, int64_t bytes) {
+    GROOVE_ATOMIC_STORE(groove->budget_limit, (bytes > 0) ? bytes : 0);
+    groove_budget_wake(groove);
+}
+
+int64_t groove_get_buffer_usage(struct Groove *groove) {
+    return GROOVE_ATOMIC_LOAD(groove->budget_used);
+}
+
+void groove_budget_charge(struct Groove *groove, int64_t bytes) {
+    GROOVE_ATOMIC_FETCH_ADD(groove->budget_used, bytes);
+}
+
+void groove_budget_release(struct Groove *groove, int64_t bytes) {
+    int64_t used = GROOVE_ATOMIC_FETCH_ADD(groove->budget_used, -bytes) - bytes;
+    int64_t limit = GROOVE_ATOMIC_LOAD(groove->budget_limit);
+    // only the release which brings usage back under the limit needs to wake
+    // anybody up
+    if (limit > 0 && used < limit && used + bytes >= limit) {
+        pthread_mutex_lock(&groove->budget_mutex);
+        pthread_cond_broadcast(&groove->budget_cond);
+        pthread_mutex_unlock(&groove->budget_mutex);
+    }
+}
+
+bool groove_budget_exhausted(struct Groove *groove) {
+    int64_t limit = GROOVE_ATOMIC_LOAD(groove->budget_limit);
+    return limit > 0 && GROOVE_ATOMIC_LOAD(groove->budget_used) >= limit;
+}
+
+long groove_budget_wake_count(struct Groove *groove) {
+    return GROOVE_ATOMIC_LOAD(groove->budget_wake_count);
+}
+
+void groove_budget_wait(struct Groove *groove, long wake_count) {
+    pthread_mutex_lock(&groove->budget_mutex);
+    while (groove_budget_exhausted(groove) &&
+            GROOVE_ATOMIC_LOAD(groove->budget_wake_count) == wake_count)
+    {
+        pthread_cond_wait(&groove->budget_cond, &groove->budget_mutex);
+    }
+    pthread_mutex_unlock(&groove->budget_mutex);
+}
+
+void groove_budget_wake(struct Groove *groove) {
+    pthread_mutex_lock(&groove->budget_mutex);
+    GROOVE_ATOMIC_FETCH_ADD(groove->budget_wake_count, 1);
+    pthread_cond_broadcast(&groove->budget_cond);
+    pthread_mutex_unlock(&groove->budget_mutex);
+}
+
 void groove_set_logging(int level) {
     av_log_set_level(level);
 }
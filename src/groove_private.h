@@ -9,9 +9,36 @@
 #define GROOVE_GROOVE_PRIVATE_H
 
 #include "groove_internal.h"
+#include "atomics.h"
+
+#include <stdbool.h>
+#include <pthread.h>
 
 struct Groove {
-    int trash; // exists to make the struct non-empty
+    // this mutex applies to budget_cond
+    pthread_mutex_t budget_mutex;
+    bool budget_mutex_inited;
+    // decode threads wait on this cond while the buffer budget is exhausted
+    pthread_cond_t budget_cond;
+    bool budget_cond_inited;
+    struct GrooveAtomicLongLong budget_limit; // in bytes. 0 means no limit
+    struct GrooveAtomicLongLong budget_used; // in bytes
+    // incremented by groove_budget_wake
+    struct GrooveAtomicLong budget_wake_count;
 };
 
+// Account for decoded audio against the buffer budget. See
+// ::groove_set_buffer_budget
+void groove_budget_charge(struct Groove *groove, int64_t bytes);
+void groove_budget_release(struct Groove *groove, int64_t bytes);
+bool groove_budget_exhausted(struct Groove *groove);
+
+// Read the wake count before checking any condition that groove_budget_wake
+// is used to announce, then pass it to groove_budget_wait. The wait returns
+// once the budget is no longer exhausted or groove_budget_wake has been
+// called since the wake count was read.
+long groove_budget_wake_count(struct Groove *groove);
+void groove_budget_wait(struct Groove *groove, long wake_count);
+void groove_budget_wake(struct Groove *groove);
+
 #endif
@@ -10,6 +10,7 @@
 #include "queue.h"
 #include "util.h"
 #include "atomics.h"
+#include "trace.h"
 
 #include <ebur128.h>
 
@@ -46,9 +47,6 @@ struct GrooveLoudnessDetectorPrivate {
     double track_duration;
     double album_duration;
 
-    // set temporarily
-    struct GroovePlaylistItem *purge_item;
-
     struct GrooveAtomicBool abort_request;
 };
 
@@ -98,6 +96,8 @@ static void *detect_thread(void *arg) {
     struct GrooveLoudnessDetector *detector = &d->externals;
     struct GrooveBuffer *buffer;
 
+    groove_trace_thread_name("loudness detector");
+
     pthread_mutex_lock(&d->info_head_mutex);
     while (!GROOVE_ATOMIC_LOAD(d->abort_request)) {
         if (d->info_queue_count >= detector->info_queue_size) {
@@ -116,7 +116,9 @@ static void *detect_thread(void *arg) {
 
         if (result == GROOVE_BUFFER_END) {
             // last file info
+            GROOVE_TRACE_BEGIN("emit_track_info");
             emit_track_info(d);
+            GROOVE_TRACE_END("emit_track_info");
 
             // send album info
             struct GrooveLoudnessDetectorInfo *info = ALLOCATE(struct GrooveLoudnessDetectorInfo, 1);
@@ -155,7 +157,9 @@ static void *detect_thread(void *arg) {
 
         if (buffer->item != d->info_head) {
             if (d->all_track_states[d->cur_track_index]) {
+                GROOVE_TRACE_BEGIN("emit_track_info");
                 emit_track_info(d);
+                GROOVE_TRACE_END("emit_track_info");
                 if (detector->disable_album) {
                     ebur128_destroy(&d->all_track_states[d->cur_track_index]);
                 } else {
@@ -213,20 +217,16 @@ static void info_queue_get(struct GrooveQueue *queue, void *obj) {
         pthread_cond_signal(&d->drain_cond);
 }
 
-static int info_queue_purge(struct GrooveQueue* queue, void *obj) {
+static void *info_queue_group(struct GrooveQueue* queue, void *obj) {
     struct GrooveLoudnessDetectorInfo *info = (struct GrooveLoudnessDetectorInfo *)obj;
-    struct GrooveLoudnessDetectorPrivate *d = (struct GrooveLoudnessDetectorPrivate *)queue->context;
-
-    return info->item == d->purge_item;
+    return info->item;
 }
 
 static void sink_purge(struct GrooveSink *sink, struct GroovePlaylistItem *item) {
     struct GrooveLoudnessDetectorPrivate *d = (struct GrooveLoudnessDetectorPrivate *)sink->userdata;
 
     pthread_mutex_lock(&d->info_head_mutex);
-    d->purge_item = item;
-    groove_queue_purge(d->info_queue);
-    d->purge_item = NULL;
+    groove_queue_purge(d->info_queue, item);
 
     if (d->info_head == item) {
         d->info_head = NULL;
@@ -289,7 +289,7 @@ struct GrooveLoudnessDetector *groove_loudness_detector_create(struct Groove *gr
     d->info_queue->cleanup = info_queue_cleanup;
     d->info_queue->put = info_queue_put;
     d->info_queue->get = info_queue_get;
-    d->info_queue->purge = info_queue_purge;
+    d->info_queue->group = info_queue_group;
 
     d->sink = groove_sink_create(groove);
     if (!d->sink) {
@@ -403,11 +403,17 @@ int groove_loudness_detector_detach(struct GrooveLoudnessDetector *detector) {
 
 int groove_loudness_detector_info_get(struct GrooveLoudnessDetector *detector,
         struct GrooveLoudnessDetectorInfo *info, int block)
+{
+    return groove_loudness_detector_info_get_timeout(detector, info, block ? -1.0 : 0.0);
+}
+
+int groove_loudness_detector_info_get_timeout(struct GrooveLoudnessDetector *detector,
+        struct GrooveLoudnessDetectorInfo *info, double seconds)
 {
     struct GrooveLoudnessDetectorPrivate *d = (struct GrooveLoudnessDetectorPrivate *) detector;
 
     struct GrooveLoudnessDetectorInfo *info_ptr;
-    if (groove_queue_get(d->info_queue, (void**)&info_ptr, block) == 1) {
+    if (groove_queue_get_timeout(d->info_queue, (void**)&info_ptr, seconds) == 1) {
         *info = *info_ptr;
         DEALLOCATE(info_ptr);
         return 1;
@@ -416,6 +422,18 @@ int groove_loudness_detector_info_get(struct GrooveLoudnessDetector *detector,
     return 0;
 }
 
+int groove_loudness_detector_get_fd(struct GrooveLoudnessDetector *detector) {
+    struct GrooveLoudnessDetectorPrivate *d = (struct GrooveLoudnessDetectorPrivate *) detector;
+    return groove_queue_get_fd(d->info_queue);
+}
+
+void groove_loudness_detector_get_stats(struct GrooveLoudnessDetector *detector,
+        struct GrooveSinkStats *stats)
+{
+    struct GrooveLoudnessDetectorPrivate *d = (struct GrooveLoudnessDetectorPrivate *) detector;
+    groove_sink_get_stats(d->sink, stats);
+}
+
 int groove_loudness_detector_info_peek(struct GrooveLoudnessDetector *detector,
         int block)
 {
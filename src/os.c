@@ -53,6 +53,7 @@
 #else
 
 #include <pthread.h>
+#include <sched.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -60,6 +61,10 @@
 
 #endif
 
+#if !defined(GROOVE_OS_WINDOWS) && !defined(__FreeBSD__) && !defined(__MACH__)
+#include <semaphore.h>
+#endif
+
 #if defined(__FreeBSD__) || defined(__MACH__)
 #define GROOVE_OS_KQUEUE
 #include <sys/types.h>
@@ -116,6 +121,21 @@ struct GrooveOsCond {
 };
 #endif
 
+#if defined(GROOVE_OS_KQUEUE)
+struct GrooveOsSem {
+    int kq_id;
+};
+#elif defined(GROOVE_OS_WINDOWS)
+struct GrooveOsSem {
+    HANDLE handle;
+};
+#else
+struct GrooveOsSem {
+    sem_t id;
+    bool id_init;
+};
+#endif
+
 #if defined(GROOVE_OS_WINDOWS)
 static INIT_ONCE win32_init_once = INIT_ONCE_STATIC_INIT;
 static double win32_time_resolution;
@@ -227,6 +247,14 @@ void groove_os_thread_destroy(struct GrooveOsThread *thread) {
     free(thread);
 }
 
+void groove_os_yield(void) {
+#if defined(GROOVE_OS_WINDOWS)
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
 struct GrooveOsMutex *groove_os_mutex_create(void) {
     struct GrooveOsMutex *mutex = ALLOCATE(struct GrooveOsMutex, 1);
     if (!mutex) {
@@ -499,6 +527,107 @@ void groove_os_cond_wait(struct GrooveOsCond *cond,
 #endif
 }
 
+struct GrooveOsSem *groove_os_sem_create(void) {
+    struct GrooveOsSem *sem = ALLOCATE(struct GrooveOsSem, 1);
+
+    if (!sem)
+        return NULL;
+
+#if defined(GROOVE_OS_WINDOWS)
+    // a maximum count of 1 makes extra posts fail harmlessly
+    sem->handle = CreateSemaphore(NULL, 0, 1, NULL);
+    if (!sem->handle) {
+        groove_os_sem_destroy(sem);
+        return NULL;
+    }
+#elif defined(GROOVE_OS_KQUEUE)
+    sem->kq_id = kqueue();
+    if (sem->kq_id == -1) {
+        groove_os_sem_destroy(sem);
+        return NULL;
+    }
+    // registered up front so that a post before the first wait is kept
+    struct kevent kev;
+    memset(&kev, 0, sizeof(kev));
+    kev.ident = notify_ident;
+    kev.filter = EVFILT_USER;
+    kev.flags = EV_ADD | EV_CLEAR;
+    if (kevent(sem->kq_id, &kev, 1, NULL, 0, NULL) == -1) {
+        groove_os_sem_destroy(sem);
+        return NULL;
+    }
+#else
+    if (sem_init(&sem->id, 0, 0)) {
+        groove_os_sem_destroy(sem);
+        return NULL;
+    }
+    sem->id_init = true;
+#endif
+
+    return sem;
+}
+
+void groove_os_sem_destroy(struct GrooveOsSem *sem) {
+    if (!sem)
+        return;
+
+#if defined(GROOVE_OS_WINDOWS)
+    if (sem->handle)
+        CloseHandle(sem->handle);
+#elif defined(GROOVE_OS_KQUEUE)
+    if (sem->kq_id != -1)
+        close(sem->kq_id);
+#else
+    if (sem->id_init)
+        assert_no_err(sem_destroy(&sem->id));
+#endif
+
+    free(sem);
+}
+
+void groove_os_sem_post(struct GrooveOsSem *sem) {
+#if defined(GROOVE_OS_WINDOWS)
+    ReleaseSemaphore(sem->handle, 1, NULL);
+#elif defined(GROOVE_OS_KQUEUE)
+    struct kevent kev;
+    struct timespec timeout = { 0, 0 };
+
+    memset(&kev, 0, sizeof(kev));
+    kev.ident = notify_ident;
+    kev.filter = EVFILT_USER;
+    kev.fflags = NOTE_TRIGGER;
+
+    if (kevent(sem->kq_id, &kev, 1, NULL, 0, &timeout) == -1) {
+        if (errno == EINTR)
+            return;
+        assert(0); // kevent signal error
+    }
+#else
+    sem_post(&sem->id);
+#endif
+}
+
+void groove_os_sem_wait(struct GrooveOsSem *sem) {
+#if defined(GROOVE_OS_WINDOWS)
+    WaitForSingleObject(sem->handle, INFINITE);
+#elif defined(GROOVE_OS_KQUEUE)
+    struct kevent out_kev;
+    while (kevent(sem->kq_id, NULL, 0, &out_kev, 1, NULL) == -1) {
+        if (errno != EINTR) {
+            assert(0); // kevent wait error
+            return;
+        }
+    }
+#else
+    while (sem_wait(&sem->id)) {
+        assert(errno == EINTR);
+    }
+    // take the posts which piled up meanwhile, so that one wakeup covers
+    // all of them like on the other systems
+    while (sem_trywait(&sem->id) == 0) {}
+#endif
+}
+
 static int get_random_seed(uint32_t *seed) {
     int fd = open("/dev/random", O_RDONLY|O_NONBLOCK);
     if (fd == -1)
@@ -25,6 +25,9 @@ int groove_os_thread_create(
 
 void groove_os_thread_destroy(struct GrooveOsThread *thread);
 
+// gives up the rest of the calling thread's time slice
+void groove_os_yield(void);
+
 
 struct GrooveOsMutex;
 struct GrooveOsMutex *groove_os_mutex_create(void);
@@ -48,4 +51,14 @@ void groove_os_cond_timed_wait(struct GrooveOsCond *cond,
 void groove_os_cond_wait(struct GrooveOsCond *cond,
         struct GrooveOsMutex *locked_mutex);
 
+// wakes one waiting thread without a lost wakeup: a post made while nobody
+// is waiting makes the next wait return at once. any number of posts before
+// a wait returns may be taken by that one wait. posting never blocks or
+// takes a lock, so the audio callback may do it.
+struct GrooveOsSem;
+struct GrooveOsSem *groove_os_sem_create(void);
+void groove_os_sem_destroy(struct GrooveOsSem *sem);
+void groove_os_sem_post(struct GrooveOsSem *sem);
+void groove_os_sem_wait(struct GrooveOsSem *sem);
+
 #endif
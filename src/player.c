@@ -11,23 +11,93 @@
 #include "util.h"
 #include "atomics.h"
 #include "os.h"
+#include "trace.h"
+#include "probes.h"
+#include "area.h"
+#include "ring.h"
+#include "virtual_device.h"
+#include "follower.h"
 
 #include <soundio/soundio.h>
 #include <assert.h>
+#include <string.h>
+
+// number of buffers which can be on their way to, or back from, the audio
+// callback at once
+#define RING_CAPACITY 64
+
+// number of events which the soundio callbacks can have waiting for the
+// helper thread
+#define EVENT_RING_CAPACITY 64
+
+// with use_adaptive_buffering, how the sink buffer size changes after an
+// underrun or near miss, and after BUFFER_STEADY_SECONDS without either
+#define BUFFER_GROW_FACTOR 2.0
+#define BUFFER_SHRINK_FACTOR 0.75
+#define BUFFER_STEADY_SECONDS 30.0
+// a near miss is the queue running down below this fraction of its size
+#define BUFFER_LOW_FRACTION 0.25
+
+// the least audio the helper thread keeps queued for the audio callback.
+// two device buffers alone would leave a low latency device at the mercy of
+// the helper thread waking up within a few milliseconds.
+#define RING_MIN_SECONDS 0.05
+
+// the outstream functions which differ between a sound card and the virtual
+// device
+struct OutStreamOps {
+    void (*destroy)(struct SoundIoOutStream *outstream);
+    int (*open)(struct SoundIoOutStream *outstream);
+    int (*start)(struct SoundIoOutStream *outstream);
+    int (*pause)(struct SoundIoOutStream *outstream, bool pause);
+    int (*clear_buffer)(struct SoundIoOutStream *outstream);
+    int (*get_latency)(struct SoundIoOutStream *outstream, double *out_latency);
+    int (*begin_write)(struct SoundIoOutStream *outstream,
+            struct SoundIoChannelArea **areas, int *frame_count);
+    int (*end_write)(struct SoundIoOutStream *outstream);
+};
+
+static const struct OutStreamOps soundio_outstream_ops = {
+    .destroy = soundio_outstream_destroy,
+    .open = soundio_outstream_open,
+    .start = soundio_outstream_start,
+    .pause = soundio_outstream_pause,
+    .clear_buffer = soundio_outstream_clear_buffer,
+    .get_latency = soundio_outstream_get_latency,
+    .begin_write = soundio_outstream_begin_write,
+    .end_write = soundio_outstream_end_write,
+};
+
+static const struct OutStreamOps virtual_outstream_ops = {
+    .destroy = groove_virtual_outstream_destroy,
+    .open = groove_virtual_outstream_open,
+    .start = groove_virtual_outstream_start,
+    .pause = groove_virtual_outstream_pause,
+    .clear_buffer = groove_virtual_outstream_clear_buffer,
+    .get_latency = groove_virtual_outstream_get_latency,
+    .begin_write = groove_virtual_outstream_begin_write,
+    .end_write = groove_virtual_outstream_end_write,
+};
+
+struct EventSlot {
+    // the position this slot will next be written at, or that position + 1
+    // once the event in it is ready to be read
+    struct GrooveAtomicLong seq;
+    enum GroovePlayerEventType type;
+};
 
 struct GroovePlayerPrivate {
     struct GroovePlayer externals;
 
     struct Groove *groove;
+
+    // owned by the audio callback. other threads may only touch these
+    // between acquire_callback_state and release_callback_state.
     struct GrooveBuffer *audio_buf;
     size_t audio_buf_size; // in frames
     size_t audio_buf_index; // in frames
-
-    int device_buffer_frames;
-    int silence_frames_left;
-
-    // this mutex applies to the variables in this block
-    struct GrooveOsMutex *play_head_mutex;
+    // false until the callback has checked audio_buf's item and format
+    bool audio_buf_begun;
     // pointer to current item where the buffered audio is reaching the device
     struct GroovePlaylistItem *play_head;
     // number of seconds into the play_head song where the buffered audio
@@ -35,23 +105,132 @@ struct GroovePlayerPrivate {
     double play_pos;
     // adjustment which takes into account hardware latency and sound card buffer
     double play_pos_adjustment;
+    int silence_frames_left;
+    // with the virtual device, the stretch of uninterrupted playback which
+    // measure_drift is comparing the position against the device over
+    struct GroovePlaylistItem *drift_item;
+    double drift_base;
+    double drift_start_pos;
+    double drift_start_played;
+    long long drift_underruns;
+
+    // held by the audio callback while it runs, and by other threads while
+    // they change the callback's state. the callback never waits for it; if
+    // another thread has it, that period is played as silence.
+    struct GrooveAtomicBool callback_lock;
+
+    // buffers on their way to the audio callback. the helper thread pushes
+    // and the callback pops. NULL marks the end of the playlist.
+    struct GrooveRing *buffer_ring;
+    // buffers the audio callback is done with, for the helper thread to unref
+    struct GrooveRing *spent_ring;
+    // frames of audio in buffer_ring
+    struct GrooveAtomicLong ring_frame_count;
+    // buffers pushed to buffer_ring which have not been unreffed yet
+    struct GrooveAtomicInt outstanding_count;
+    struct GrooveAtomicBool ring_contains_end;
+    // set by the audio callback when it has signalled the helper thread
+    struct GrooveAtomicBool helper_wake_pending;
+
+    // events from the soundio callbacks. any of them may push, without
+    // locking or allocating; the helper thread pops them into eventq.
+    struct EventSlot event_slots[EVENT_RING_CAPACITY];
+    struct GrooveAtomicLong event_head;
+    long event_tail; // helper thread only
+    // one bit per event type that was dropped because the ring was full
+    struct GrooveAtomicInt event_overflow;
+    // set while a BUFFERUNDERRUN is waiting for the helper thread, so that
+    // a burst of underruns is reported once
+    struct GrooveAtomicBool underrun_pending;
+
+    // the play head as last published by the audio callback, for
+    // groove_player_position. odd while it is being written.
+    struct GrooveAtomicLong position_seq;
+    struct GrooveAtomicPtr position_item;
+    // seconds into position_item of the last frame written to the device
+    struct GrooveAtomicDouble position_pos;
+    struct GrooveAtomicDouble position_adjustment;
+    // groove_os_get_time when position_adjustment was measured
+    struct GrooveAtomicDouble position_time;
+    // whether the device was being fed audio rather than silence, so that
+    // readers can move the position on by the time since position_time
+    struct GrooveAtomicBool position_playing;
+
+    // copied from the public fields at attach time
+    double target_latency;
+    double buffer_duration;
+    double prebuffer_duration;
+    bool use_adaptive_buffering;
+    double min_buffer_duration;
+    bool use_fixed_format;
+    bool use_direct_render;
+    bool use_virtual_device;
+    double virtual_speed;
+    const struct OutStreamOps *outstream_ops;
+
+    // with use_direct_render, the sample format the device is opened with and
+    // the gain the audio callback applies. the sink always gets float.
+    enum SoundIoFormat direct_format;
+    struct GrooveAtomicDouble direct_gain;
+
+    // measurements of the virtual device, kept across re-opens
+    struct GrooveVirtualDeviceCounters virtual_counters;
+
+    // one per extra device, created at attach time. the audio callback
+    // copies everything it plays into each of them.
+    struct GrooveFollower **followers;
+    int follower_count;
+
+    // written by the helper thread before the outstream starts
+    int device_buffer_frames;
 
-    bool prebuffering;
-    bool is_paused;
+    // the sink buffer size in seconds. only the helper thread writes it.
+    struct GrooveAtomicDouble buffer_target;
+    // helper thread only. the bounds of buffer_target for the device as it
+    // was opened, and the state of adaptive buffering.
+    double buffer_target_min;
+    double buffer_target_max;
+    bool buffer_running_low;
+    double buffer_steady_since;
+    // whether the queue has been half full since playback last (re)started.
+    // prebuffering may stop well short of that, so until then a low queue
+    // is not a near miss.
+    bool buffer_filled;
+    // set when buffer_target has changed but the sink has not been resized
+    bool buffer_target_dirty;
+
+    struct GrooveAtomicBool prebuffering;
+    struct GrooveAtomicBool is_paused;
+    // false from when the callback starts counting down silence_frames_left
+    // until it reaches zero
+    struct GrooveAtomicBool silence_played;
+    struct GrooveAtomicBool request_device_close;
+    struct GrooveAtomicBool request_device_open;
+
+    // this mutex applies to the variables in this block. the audio callback
+    // never takes it.
+    struct GrooveOsMutex *helper_mutex;
     bool is_started;
-
     struct SoundIoOutStream *outstream;
-    struct GrooveSink *sink;
-
-    struct GrooveQueue *eventq;
-
+    struct GrooveAudioFormat device_format;
     // watchdog thread for opening and closing audio device
     bool abort_request;
+    // the item of every buffer counted in outstanding_count, so that
+    // sink_purge can tell without the callback state whether the callback
+    // could have anything of an item
+    struct GroovePlaylistItem *outstanding_items[RING_CAPACITY];
+    int outstanding_item_count;
+    // the item of the last buffer taken back from spent_ring, which may
+    // still be the play head
+    struct GroovePlaylistItem *last_spent_item;
     struct GrooveOsThread *helper_thread;
-    struct GrooveOsCond *helper_thread_cond;
-    bool request_device_close;
-    bool request_device_open;
-    struct GrooveAudioFormat device_format;
+    // posted whenever the helper thread has something to do. unlike a
+    // condition variable, posting takes no lock and is never lost, so the
+    // audio callback can post and the helper thread need not poll.
+    struct GrooveOsSem *helper_sem;
+
+    struct GrooveSink *sink;
+    struct GrooveQueue *eventq;
 };
 
 static enum SoundIoFormat prioritized_formats[] = {
@@ -99,28 +278,322 @@ static void emit_event(struct GrooveQueue *queue, enum GroovePlayerEventType typ
         av_log(NULL, AV_LOG_ERROR, "unable to put event on queue: out of memory\n");
 }
 
+// waits until the audio callback is not running and keeps it away from its
+// state until release_callback_state. the callback is short and never
+// blocks, so this does not wait long.
+static void acquire_callback_state(struct GroovePlayerPrivate *p) {
+    while (GROOVE_ATOMIC_EXCHANGE(p->callback_lock, true))
+        groove_os_yield();
+}
+
+static void release_callback_state(struct GroovePlayerPrivate *p) {
+    GROOVE_ATOMIC_STORE(p->callback_lock, false);
+}
+
+// a seqlock, so that neither side ever waits for the other. only called by
+// whoever holds the callback state.
+static void publish_position(struct GroovePlayerPrivate *p, bool playing) {
+    double pos = p->play_pos;
+    if (p->audio_buf && p->audio_buf_begun && pos >= 0.0)
+        pos += p->audio_buf_index / (double)p->audio_buf->format.sample_rate;
+    double now = groove_os_get_time();
+
+    long seq = GROOVE_ATOMIC_LOAD_RELAXED(p->position_seq);
+    GROOVE_ATOMIC_STORE_RELAXED(p->position_seq, seq + 1);
+    atomic_thread_fence(memory_order_release);
+    GROOVE_ATOMIC_STORE_RELAXED(p->position_item, p->play_head);
+    GROOVE_ATOMIC_STORE_RELAXED(p->position_pos, pos);
+    GROOVE_ATOMIC_STORE_RELAXED(p->position_adjustment, p->play_pos_adjustment);
+    GROOVE_ATOMIC_STORE_RELAXED(p->position_time, now);
+    GROOVE_ATOMIC_STORE_RELAXED(p->position_playing, playing);
+    GROOVE_ATOMIC_STORE(p->position_seq, seq + 2);
+}
+
+// called from the audio callback, which must not block on the helper mutex
+static void wake_helper(struct GroovePlayerPrivate *p) {
+    if (!GROOVE_ATOMIC_EXCHANGE(p->helper_wake_pending, true))
+        groove_os_sem_post(p->helper_sem);
+}
+
+// helper thread only, with helper_mutex held
+static void wait_for_wakeup(struct GroovePlayerPrivate *p) {
+    groove_os_mutex_unlock(p->helper_mutex);
+    groove_os_sem_wait(p->helper_sem);
+    groove_os_mutex_lock(p->helper_mutex);
+}
+
+static void reset_event_ring(struct GroovePlayerPrivate *p) {
+    for (long i = 0; i < EVENT_RING_CAPACITY; i += 1)
+        GROOVE_ATOMIC_STORE(p->event_slots[i].seq, i);
+    GROOVE_ATOMIC_STORE(p->event_head, 0);
+    p->event_tail = 0;
+    GROOVE_ATOMIC_STORE(p->event_overflow, 0);
+    GROOVE_ATOMIC_STORE(p->underrun_pending, false);
+}
+
+// for the soundio callbacks, which must not allocate or lock
+static void emit_callback_event(struct GroovePlayerPrivate *p, enum GroovePlayerEventType type) {
+    if (type == GROOVE_EVENT_BUFFERUNDERRUN && GROOVE_ATOMIC_EXCHANGE(p->underrun_pending, true))
+        return;
+
+    long pos = GROOVE_ATOMIC_LOAD(p->event_head);
+    for (;;) {
+        struct EventSlot *slot = &p->event_slots[pos % EVENT_RING_CAPACITY];
+        long seq = GROOVE_ATOMIC_LOAD(slot->seq);
+        if (seq == pos) {
+            if (GROOVE_ATOMIC_COMPARE_EXCHANGE(p->event_head, pos, pos + 1)) {
+                slot->type = type;
+                GROOVE_ATOMIC_STORE(slot->seq, pos + 1);
+                break;
+            }
+        } else if (seq < pos) {
+            // full. the helper thread emits one of these once it catches up.
+            GROOVE_ATOMIC_FETCH_OR(p->event_overflow, 1 << type);
+            break;
+        } else {
+            pos = GROOVE_ATOMIC_LOAD(p->event_head);
+        }
+    }
+    wake_helper(p);
+}
+
+// helper thread only. see apply_buffer_target.
+static void set_buffer_target(struct GroovePlayerPrivate *p, double seconds) {
+    GROOVE_ATOMIC_STORE(p->buffer_target, seconds);
+    p->buffer_target_dirty = true;
+    p->buffer_steady_since = groove_os_get_time();
+}
+
+// helper thread only, with helper_mutex held. resizing the sink takes the
+// playlist's decode_head_mutex, which the decode thread holds while calling
+// sink_filled and sink_purge, which take helper_mutex. so the mutex is let
+// go meanwhile, and this returns true if it was.
+static bool apply_buffer_target(struct GroovePlayerPrivate *p) {
+    if (!p->buffer_target_dirty)
+        return false;
+    p->buffer_target_dirty = false;
+    double seconds = GROOVE_ATOMIC_LOAD(p->buffer_target);
+    groove_os_mutex_unlock(p->helper_mutex);
+    groove_sink_set_buffer_size_seconds(p->sink, seconds);
+    groove_os_mutex_lock(p->helper_mutex);
+    return true;
+}
+
+// helper thread only, after an underrun or a near miss. grows the sink
+// buffer once for each time the queue runs low.
+static void grow_buffer_target(struct GroovePlayerPrivate *p) {
+    if (!p->use_adaptive_buffering || !p->outstream || p->buffer_running_low)
+        return;
+    p->buffer_running_low = true;
+    double target = GROOVE_ATOMIC_LOAD(p->buffer_target);
+    set_buffer_target(p, groove_min_double(target * BUFFER_GROW_FACTOR, p->buffer_target_max));
+}
+
+// helper thread, or any thread holding helper_mutex. moves events from the
+// soundio callbacks to eventq.
+static void dispatch_callback_events(struct GroovePlayerPrivate *p) {
+    for (;;) {
+        struct EventSlot *slot = &p->event_slots[p->event_tail % EVENT_RING_CAPACITY];
+        if (GROOVE_ATOMIC_LOAD(slot->seq) != p->event_tail + 1)
+            break;
+        enum GroovePlayerEventType type = slot->type;
+        GROOVE_ATOMIC_STORE(slot->seq, p->event_tail + EVENT_RING_CAPACITY);
+        p->event_tail += 1;
+
+        if (type == GROOVE_EVENT_BUFFERUNDERRUN) {
+            GROOVE_ATOMIC_STORE(p->underrun_pending, false);
+            grow_buffer_target(p);
+        }
+        emit_event(p->eventq, type);
+    }
+
+    int overflow = GROOVE_ATOMIC_EXCHANGE(p->event_overflow, 0);
+    for (int type = 0; overflow; type += 1) {
+        if (!(overflow & (1 << type)))
+            continue;
+        overflow &= ~(1 << type);
+        if (type == GROOVE_EVENT_BUFFERUNDERRUN) {
+            GROOVE_ATOMIC_STORE(p->underrun_pending, false);
+            grow_buffer_target(p);
+        }
+        emit_event(p->eventq, (enum GroovePlayerEventType)type);
+    }
+}
+
+// helper thread, or any thread holding helper_mutex. anything the callbacks
+// emitted before this goes first.
+static void emit_helper_event(struct GroovePlayerPrivate *p, enum GroovePlayerEventType type) {
+    dispatch_callback_events(p);
+    emit_event(p->eventq, type);
+}
+
+// the outstanding_items functions need helper_mutex, or the helper thread
+static void forget_outstanding_item(struct GroovePlayerPrivate *p, struct GroovePlaylistItem *item) {
+    for (int i = 0; i < p->outstanding_item_count; i += 1) {
+        if (p->outstanding_items[i] == item) {
+            p->outstanding_item_count -= 1;
+            memmove(&p->outstanding_items[i], &p->outstanding_items[i + 1],
+                    (p->outstanding_item_count - i) * sizeof(p->outstanding_items[0]));
+            return;
+        }
+    }
+}
+
+static bool item_is_outstanding(struct GroovePlayerPrivate *p, struct GroovePlaylistItem *item) {
+    for (int i = 0; i < p->outstanding_item_count; i += 1) {
+        if (p->outstanding_items[i] == item)
+            return true;
+    }
+    return false;
+}
+
+// must be called with the callback state held and, unless the caller is the
+// helper thread, with helper_mutex held so that nothing is pushed meanwhile
+static void unref_ring_buffer(struct GroovePlayerPrivate *p, struct GrooveBuffer *buffer) {
+    GROOVE_ATOMIC_FETCH_ADD(p->ring_frame_count, -buffer->frame_count);
+    GROOVE_ATOMIC_FETCH_ADD(p->outstanding_count, -1);
+    forget_outstanding_item(p, buffer->item);
+    groove_buffer_unref(buffer);
+}
+
+static void drop_audio_buf(struct GroovePlayerPrivate *p) {
+    if (p->audio_buf) {
+        GROOVE_ATOMIC_FETCH_ADD(p->outstanding_count, -1);
+        forget_outstanding_item(p, p->audio_buf->item);
+        groove_buffer_unref(p->audio_buf);
+    }
+    p->audio_buf = NULL;
+    p->audio_buf_index = 0;
+    p->audio_buf_size = 0;
+}
+
+// helper thread only
+static void release_spent_buffers(struct GroovePlayerPrivate *p) {
+    void *obj;
+    while (groove_ring_pop(p->spent_ring, &obj)) {
+        struct GrooveBuffer *buffer = (struct GrooveBuffer *)obj;
+        GROOVE_ATOMIC_FETCH_ADD(p->outstanding_count, -1);
+        forget_outstanding_item(p, buffer->item);
+        p->last_spent_item = buffer->item;
+        groove_buffer_unref(buffer);
+    }
+}
+
+// helper thread only. moves buffers from the sink to the audio callback until
+// the callback has a couple of device buffers, and at least RING_MIN_SECONDS,
+// worth queued up.
+static void fill_buffer_ring(struct GroovePlayerPrivate *p) {
+    long min_frames = ceil(RING_MIN_SECONDS * p->device_format.sample_rate);
+    long target_frames = groove_max_long(groove_max_long(p->device_buffer_frames * 2, min_frames), 1);
+    while (GROOVE_ATOMIC_LOAD(p->ring_frame_count) < target_frames &&
+           GROOVE_ATOMIC_LOAD(p->outstanding_count) < RING_CAPACITY - 1 &&
+           groove_ring_count(p->buffer_ring) < RING_CAPACITY)
+    {
+        struct GrooveBuffer *buffer;
+        int ret = groove_sink_buffer_get(p->sink, &buffer, 0);
+        if (ret == GROOVE_BUFFER_END) {
+            GROOVE_ATOMIC_STORE(p->ring_contains_end, true);
+            groove_ring_push(p->buffer_ring, NULL);
+        } else if (ret == GROOVE_BUFFER_YES) {
+            GROOVE_ATOMIC_FETCH_ADD(p->outstanding_count, 1);
+            GROOVE_ATOMIC_FETCH_ADD(p->ring_frame_count, buffer->frame_count);
+            p->outstanding_items[p->outstanding_item_count++] = buffer->item;
+            groove_ring_push(p->buffer_ring, buffer);
+        } else {
+            break;
+        }
+    }
+}
+
+// helper thread only, while the outstream is closed. makes sure audio_buf
+// holds the buffer which decides the format to open the device with.
+static bool load_first_buffer(struct GroovePlayerPrivate *p) {
+    acquire_callback_state(p);
+    void *obj;
+    while (!p->audio_buf && groove_ring_pop(p->buffer_ring, &obj)) {
+        if (!obj) {
+            GROOVE_ATOMIC_STORE(p->ring_contains_end, false);
+            continue;
+        }
+        p->audio_buf = (struct GrooveBuffer *)obj;
+        p->audio_buf_index = 0;
+        p->audio_buf_size = p->audio_buf->frame_count;
+        p->audio_buf_begun = false;
+        GROOVE_ATOMIC_FETCH_ADD(p->ring_frame_count, -p->audio_buf->frame_count);
+    }
+    bool have_buffer = (p->audio_buf != NULL);
+    release_callback_state(p);
+    return have_buffer;
+}
+
+// helper thread only, while the outstream is open
+static double buffered_seconds(struct GroovePlayerPrivate *p) {
+    double ring_seconds = GROOVE_ATOMIC_LOAD(p->ring_frame_count) /
+        (double)p->device_format.sample_rate;
+    return groove_sink_get_fill_duration(p->sink) + ring_seconds;
+}
+
+// helper thread only, while the outstream is open. watches for near misses
+// and shrinks the sink buffer after a steady stretch.
+static void adapt_buffer_target(struct GroovePlayerPrivate *p) {
+    if (!p->use_adaptive_buffering)
+        return;
+
+    double now = groove_os_get_time();
+    // only time spent playing shows that the buffer is big enough, and the
+    // queue is supposed to run down at the end of the playlist and stop
+    // moving while the device closes
+    if (!p->is_started || GROOVE_ATOMIC_LOAD(p->is_paused) ||
+        GROOVE_ATOMIC_LOAD(p->ring_contains_end) || groove_sink_contains_end_of_playlist(p->sink) ||
+        GROOVE_ATOMIC_LOAD(p->prebuffering) || GROOVE_ATOMIC_LOAD(p->request_device_close))
+    {
+        p->buffer_running_low = false;
+        p->buffer_filled = false;
+        p->buffer_steady_since = now;
+        return;
+    }
+
+    double target = GROOVE_ATOMIC_LOAD(p->buffer_target);
+    double buffered = buffered_seconds(p);
+    if (p->buffer_filled && buffered < target * BUFFER_LOW_FRACTION) {
+        grow_buffer_target(p);
+        return;
+    }
+    // recovered once the queue is back up to half full
+    if (buffered >= target * 0.5) {
+        p->buffer_running_low = false;
+        p->buffer_filled = true;
+    }
+
+    if (now - p->buffer_steady_since >= BUFFER_STEADY_SECONDS && target > p->buffer_target_min)
+        set_buffer_target(p, groove_max_double(target * BUFFER_SHRINK_FACTOR, p->buffer_target_min));
+}
+
 static void close_audio_device(struct GroovePlayerPrivate *p) {
-    soundio_outstream_destroy(p->outstream);
+    if (p->outstream)
+        p->outstream_ops->destroy(p->outstream);
     p->outstream = NULL;
 }
 
 static void error_callback(struct SoundIoOutStream *outstream, int err) {
     struct GroovePlayerPrivate *p = (struct GroovePlayerPrivate *)outstream->userdata;
     av_log(NULL, AV_LOG_ERROR, "stream error: %s\n", soundio_strerror(err));
-    emit_event(p->eventq, GROOVE_EVENT_STREAM_ERROR);
+    emit_callback_event(p, GROOVE_EVENT_STREAM_ERROR);
 }
 
 static void set_pause_state(struct GroovePlayerPrivate *p, bool new_state) {
-    p->is_paused = new_state;
+    GROOVE_ATOMIC_STORE(p->is_paused, new_state);
     if (p->is_started)
-        soundio_outstream_pause(p->outstream, (p->prebuffering || new_state));
+        p->outstream_ops->pause(p->outstream, (GROOVE_ATOMIC_LOAD(p->prebuffering) || new_state));
 }
 
 static void underflow_callback(struct SoundIoOutStream *outstream) {
     struct GroovePlayerPrivate *p = (struct GroovePlayerPrivate *)outstream->userdata;
-    p->prebuffering = true;
-    emit_event(p->eventq, GROOVE_EVENT_BUFFERUNDERRUN);
-    groove_os_cond_signal(p->helper_thread_cond, p->play_head_mutex);
+    groove_trace_thread_name("audio callback");
+    GROOVE_TRACE_INSTANT("underflow");
+    GROOVE_PROBE1(audio_underflow, p);
+    GROOVE_ATOMIC_STORE(p->prebuffering, true);
+    emit_callback_event(p, GROOVE_EVENT_BUFFERUNDERRUN);
 }
 
 static bool audio_formats_equal_ignore_planar(
@@ -131,6 +604,195 @@ static bool audio_formats_equal_ignore_planar(
             a->format == b->format);
 }
 
+// whether the audio callback can play audio of this format on the device as
+// it was opened
+static bool device_plays_format(struct GroovePlayerPrivate *p,
+        const struct GrooveAudioFormat *format)
+{
+    if (!p->use_direct_render)
+        return audio_formats_equal_ignore_planar(format, &p->device_format);
+    // the audio callback converts the sample format
+    return (format->sample_rate == p->device_format.sample_rate &&
+            soundio_channel_layout_equal(&format->layout, &p->device_format.layout));
+}
+
+// audio callback only. plays silence for device_buffer_frames and then lets
+// the helper thread close the device.
+static void begin_device_close(struct GroovePlayerPrivate *p, bool reopen) {
+    p->silence_frames_left = p->device_buffer_frames;
+    GROOVE_ATOMIC_STORE(p->silence_played, false);
+    if (reopen)
+        GROOVE_ATOMIC_STORE(p->request_device_open, true);
+    GROOVE_ATOMIC_STORE(p->request_device_close, true);
+}
+
+// audio callback only. returns false if the device has to be reopened before
+// audio_buf can be played.
+static bool begin_audio_buf(struct GroovePlayerPrivate *p) {
+    if (p->play_head != p->audio_buf->item)
+        emit_callback_event(p, GROOVE_EVENT_NOWPLAYING);
+
+    p->play_head = p->audio_buf->item;
+    p->play_pos = p->audio_buf->pos;
+
+    if (!device_plays_format(p, &p->audio_buf->format)) {
+        begin_device_close(p, true);
+        wake_helper(p);
+        return false;
+    }
+    p->audio_buf_begun = true;
+    return true;
+}
+
+// audio callback only. returns false if there is nothing to play yet.
+static bool next_audio_buf(struct GroovePlayerPrivate *p) {
+    if (p->audio_buf) {
+        // cannot fail; outstanding_count keeps it from ever filling up
+        groove_ring_push(p->spent_ring, p->audio_buf);
+        p->audio_buf = NULL;
+        p->audio_buf_index = 0;
+        p->audio_buf_size = 0;
+    }
+
+    void *obj;
+    if (!groove_ring_pop(p->buffer_ring, &obj))
+        return false;
+    wake_helper(p);
+
+    if (!obj) {
+        emit_callback_event(p, GROOVE_EVENT_END_OF_PLAYLIST);
+        emit_callback_event(p, GROOVE_EVENT_NOWPLAYING);
+        p->play_head = NULL;
+        p->play_pos = -1.0;
+        // a fixed format device stays open, playing silence until there is
+        // more to play
+        if (p->use_fixed_format)
+            GROOVE_ATOMIC_STORE(p->prebuffering, true);
+        else
+            begin_device_close(p, false);
+        // only now, so that the helper thread never sees the queue running
+        // dry without a reason
+        GROOVE_ATOMIC_STORE(p->ring_contains_end, false);
+        return false;
+    }
+
+    p->audio_buf = (struct GrooveBuffer *)obj;
+    p->audio_buf_size = p->audio_buf->frame_count;
+    p->audio_buf_begun = false;
+    GROOVE_ATOMIC_FETCH_ADD(p->ring_frame_count, -p->audio_buf->frame_count);
+    return begin_audio_buf(p);
+}
+
+// frames may be NULL for silence
+static void tee_to_followers(struct GroovePlayerPrivate *p, const uint8_t *frames,
+        int frame_count)
+{
+    for (int i = 0; i < p->follower_count; i += 1) {
+        if (frames)
+            groove_follower_write(p->followers[i], frames, frame_count);
+        else
+            groove_follower_write_silence(p->followers[i], frame_count);
+    }
+}
+
+// for when another thread holds the callback state
+static void write_silence(struct SoundIoOutStream *outstream, int frame_count_max) {
+    struct GroovePlayerPrivate *p = (struct GroovePlayerPrivate *)outstream->userdata;
+    struct SoundIoChannelArea *areas;
+    int frames_left = frame_count_max;
+    int err;
+
+    while (frames_left) {
+        int frame_count = frames_left;
+        if ((err = p->outstream_ops->begin_write(outstream, &areas, &frame_count))) {
+            error_callback(outstream, err);
+            return;
+        }
+        if (!frame_count)
+            break;
+        groove_area_write_silence(areas, outstream->layout.channel_count,
+                outstream->bytes_per_sample, frame_count);
+        tee_to_followers(p, NULL, frame_count);
+        frames_left -= frame_count;
+        if ((err = p->outstream_ops->end_write(outstream))) {
+            if (err == SoundIoErrorUnderflow)
+                underflow_callback(outstream);
+            else
+                error_callback(outstream, err);
+            return;
+        }
+    }
+}
+
+// what groove_player_position reports at the time now. returns whether the
+// device is being fed audio rather than silence.
+static bool read_position(struct GroovePlayerPrivate *p, double now,
+        struct GroovePlaylistItem **item, double *seconds)
+{
+    struct GroovePlaylistItem *play_head;
+    double play_pos;
+    double play_pos_adjustment;
+    double play_pos_time;
+    bool playing;
+    for (;;) {
+        long seq = GROOVE_ATOMIC_LOAD(p->position_seq);
+        if (seq & 1) {
+            groove_os_yield();
+            continue;
+        }
+        play_head = (struct GroovePlaylistItem *)GROOVE_ATOMIC_LOAD_RELAXED(p->position_item);
+        play_pos = GROOVE_ATOMIC_LOAD_RELAXED(p->position_pos);
+        play_pos_adjustment = GROOVE_ATOMIC_LOAD_RELAXED(p->position_adjustment);
+        play_pos_time = GROOVE_ATOMIC_LOAD_RELAXED(p->position_time);
+        playing = GROOVE_ATOMIC_LOAD_RELAXED(p->position_playing);
+        atomic_thread_fence(memory_order_acquire);
+        if (GROOVE_ATOMIC_LOAD_RELAXED(p->position_seq) == seq)
+            break;
+    }
+
+    if (item)
+        *item = play_head;
+
+    if (seconds) {
+        *seconds = play_pos - play_pos_adjustment;
+        // the device has been playing out its buffer since the callback
+        // looked. it cannot get further than the end of what was written.
+        // the virtual device plays virtual_speed seconds of audio per second.
+        if (playing && play_head) {
+            double elapsed = now - play_pos_time;
+            if (p->use_virtual_device)
+                elapsed *= p->virtual_speed;
+            *seconds += groove_min_double(groove_max_double(elapsed, 0.0), play_pos_adjustment);
+        }
+    }
+    return playing;
+}
+
+// audio callback only, with the virtual device. measures how far the
+// position has moved beyond the audio the device actually played, over each
+// stretch of playing one item without an underrun, and adds up the stretches.
+static void measure_drift(struct GroovePlayerPrivate *p) {
+    struct GrooveVirtualDeviceCounters *c = &p->virtual_counters;
+    struct GroovePlaylistItem *item;
+    double pos;
+    bool playing = read_position(p, groove_os_get_time(), &item, &pos);
+    double played = GROOVE_ATOMIC_LOAD_RELAXED(c->frames_played) /
+        (double)p->device_format.sample_rate;
+    long long underruns = GROOVE_ATOMIC_LOAD_RELAXED(c->underrun_count);
+
+    if (playing && item && item == p->drift_item && underruns == p->drift_underruns) {
+        double drift = p->drift_base + (pos - p->drift_start_pos) - (played - p->drift_start_played);
+        GROOVE_ATOMIC_STORE_RELAXED(c->drift_ns, (long long)(drift * 1000000000.0));
+        return;
+    }
+
+    p->drift_base = GROOVE_ATOMIC_LOAD_RELAXED(c->drift_ns) / 1000000000.0;
+    p->drift_item = playing ? item : NULL;
+    p->drift_start_pos = pos;
+    p->drift_start_played = played;
+    p->drift_underruns = underruns;
+}
+
 static void audio_callback(struct SoundIoOutStream *outstream,
         int frame_count_min, int frame_count_max)
 {
@@ -142,13 +804,25 @@ static void audio_callback(struct SoundIoOutStream *outstream,
     int channel_count = layout->channel_count;
     int frames_left = frame_count_max;
 
-    groove_os_mutex_lock(p->play_head_mutex);
+    groove_trace_thread_name("audio callback");
+    GROOVE_TRACE_BEGIN("audio_callback");
+    GROOVE_PROBE3(audio_callback_enter, p, frame_count_min, frame_count_max);
+
+    if (GROOVE_ATOMIC_EXCHANGE(p->callback_lock, true)) {
+        write_silence(outstream, frame_count_max);
+        GROOVE_TRACE_END("audio_callback");
+        return;
+    }
+
+    if (p->use_virtual_device)
+        measure_drift(p);
 
-    bool silence = p->prebuffering || p->request_device_close || p->is_paused;
+    bool silence = GROOVE_ATOMIC_LOAD(p->prebuffering) ||
+        GROOVE_ATOMIC_LOAD(p->request_device_close) || GROOVE_ATOMIC_LOAD(p->is_paused);
     while (frames_left) {
         int frame_count = frames_left;
 
-        if ((err = soundio_outstream_begin_write(outstream, &areas, &frame_count))) {
+        if ((err = p->outstream_ops->begin_write(outstream, &areas, &frame_count))) {
             error_callback(outstream, err);
             goto unlock_and_return;
         }
@@ -157,85 +831,62 @@ static void audio_callback(struct SoundIoOutStream *outstream,
             break;
 
         while (frame_count > 0) {
-            if (!silence && p->audio_buf_index >= p->audio_buf_size) {
-                groove_buffer_unref(p->audio_buf);
-                p->audio_buf_index = 0;
-                p->audio_buf_size = 0;
-
-                int ret = groove_sink_buffer_get(p->sink, &p->audio_buf, 0);
-                if (ret == GROOVE_BUFFER_END) {
-                    emit_event(p->eventq, GROOVE_EVENT_END_OF_PLAYLIST);
-                    emit_event(p->eventq, GROOVE_EVENT_NOWPLAYING);
-                    p->play_head = NULL;
-                    p->play_pos = -1.0;
-                    p->request_device_close = true;
-                    silence = true;
-                    p->silence_frames_left = p->device_buffer_frames;
-                } else if (ret == GROOVE_BUFFER_YES) {
-                    if (p->play_head != p->audio_buf->item)
-                        emit_event(p->eventq, GROOVE_EVENT_NOWPLAYING);
-
-                    p->play_head = p->audio_buf->item;
-                    p->play_pos = p->audio_buf->pos;
-                    p->audio_buf_size = p->audio_buf->frame_count;
-
-                    if (!audio_formats_equal_ignore_planar(&p->audio_buf->format, &p->device_format)) {
-                        p->request_device_close = true;
-                        p->request_device_open = true;
-                        silence = true;
-                        p->silence_frames_left = p->device_buffer_frames;
-                    }
-                } else {
-                    error_callback(outstream, SoundIoErrorUnderflow);
-                    goto unlock_and_return;
+            if (!silence && p->audio_buf && !p->audio_buf_begun && !begin_audio_buf(p))
+                silence = true;
+
+            if (!silence && p->audio_buf_index >= p->audio_buf_size && !next_audio_buf(p)) {
+                silence = true;
+                // the end of the playlist starts its own countdown, or with a
+                // fixed format its own prebuffering. otherwise the helper
+                // thread has not kept up.
+                if (!GROOVE_ATOMIC_LOAD(p->request_device_close) &&
+                    !GROOVE_ATOMIC_LOAD(p->prebuffering))
+                {
+                    underflow_callback(outstream);
                 }
             }
 
             if (silence) {
-                for (int frame = 0; frame < frame_count; frame += 1) {
-                    for (int ch = 0; ch < channel_count; ch += 1) {
-                        memset(areas[ch].ptr, 0, outstream->bytes_per_sample);
-                        areas[ch].ptr += areas[ch].step;
-                    }
-                }
+                groove_area_write_silence(areas, channel_count, outstream->bytes_per_sample,
+                        frame_count);
+                tee_to_followers(p, NULL, frame_count);
                 frames_left -= frame_count;
                 if (p->silence_frames_left > 0) {
                     p->silence_frames_left -= frame_count;
                     if (p->silence_frames_left <= 0) {
-                        groove_os_cond_signal(p->helper_thread_cond, p->play_head_mutex);
+                        GROOVE_ATOMIC_STORE(p->silence_played, true);
+                        wake_helper(p);
                     }
                 }
                 frame_count = 0;
             } else {
                 int audio_buf_frames_left = p->audio_buf_size - p->audio_buf_index;
                 int write_frame_count = groove_min_int(frame_count, audio_buf_frames_left);
-                size_t end_frame = p->audio_buf_index + write_frame_count;
-
-                if (p->audio_buf->format.is_planar) {
-                    for (; p->audio_buf_index < end_frame; p->audio_buf_index += 1) {
-                        for (int ch = 0; ch < channel_count; ch += 1) {
-                            uint8_t *source = &p->audio_buf->data[ch][p->audio_buf_index * outstream->bytes_per_sample];
-                            memcpy(areas[ch].ptr, source, outstream->bytes_per_sample);
-                            areas[ch].ptr += areas[ch].step;
-                        }
-                    }
+
+                if (p->use_direct_render) {
+                    float gain = GROOVE_ATOMIC_LOAD_RELAXED(p->direct_gain);
+                    groove_area_convert_float(areas, channel_count, outstream->format,
+                            p->audio_buf->data, p->audio_buf->format.is_planar,
+                            p->audio_buf_index, write_frame_count, gain);
+                } else if (p->audio_buf->format.is_planar) {
+                    groove_area_copy_planar(areas, channel_count, outstream->bytes_per_sample,
+                            p->audio_buf->data, p->audio_buf_index, write_frame_count);
+                    // followers imply a fixed, interleaved format
+                    tee_to_followers(p, NULL, write_frame_count);
                 } else {
                     uint8_t *source = p->audio_buf->data[0] + p->audio_buf_index * outstream->bytes_per_frame;
-                    for (; p->audio_buf_index < end_frame; p->audio_buf_index += 1) {
-                        for (int ch = 0; ch < channel_count; ch += 1) {
-                            memcpy(areas[ch].ptr, source, outstream->bytes_per_sample);
-                            areas[ch].ptr += areas[ch].step;
-                            source += outstream->bytes_per_sample;
-                        }
-                    }
+                    groove_area_copy_interleaved(areas, channel_count, outstream->bytes_per_sample,
+                            source, write_frame_count);
+                    tee_to_followers(p, source, write_frame_count);
                 }
+                p->audio_buf_index += write_frame_count;
 
                 frame_count -= write_frame_count;
                 frames_left -= write_frame_count;
             }
         }
 
-        if ((err = soundio_outstream_end_write(outstream))) {
+        if ((err = p->outstream_ops->end_write(outstream))) {
             if (err == SoundIoErrorUnderflow) {
                 underflow_callback(outstream);
                 goto unlock_and_return;
@@ -246,21 +897,41 @@ static void audio_callback(struct SoundIoOutStream *outstream,
         }
     }
 
-    soundio_outstream_get_latency(outstream, &p->play_pos_adjustment);
+    p->outstream_ops->get_latency(outstream, &p->play_pos_adjustment);
+    publish_position(p, !silence);
+    if (p->follower_count > 0) {
+        double now = groove_os_get_time();
+        // followers want wall clock time, and the latency is in seconds of
+        // audio, which the virtual device plays at virtual_speed
+        double latency = p->play_pos_adjustment;
+        if (p->use_virtual_device)
+            latency /= p->virtual_speed;
+        for (int i = 0; i < p->follower_count; i += 1)
+            groove_follower_sync(p->followers[i], now, latency);
+    }
+    release_callback_state(p);
+    GROOVE_TRACE_END("audio_callback");
+    return;
 
 unlock_and_return:
-    groove_os_mutex_unlock(p->play_head_mutex);
+    publish_position(p, false);
+    release_callback_state(p);
+    GROOVE_TRACE_END("audio_callback");
 }
 
 static int open_audio_device(struct GroovePlayerPrivate *p) {
     struct GroovePlayer *player = &p->externals;
     int err;
 
-    assert(player->device);
     assert(!p->outstream);
 
-    struct SoundIoDevice *device = player->device;
-    p->outstream = soundio_outstream_create(device);
+    if (p->use_virtual_device) {
+        p->drift_item = NULL;
+        p->outstream = groove_virtual_outstream_create(p->virtual_speed, &p->virtual_counters);
+    } else {
+        assert(player->device);
+        p->outstream = soundio_outstream_create(player->device);
+    }
     if (!p->outstream) {
         close_audio_device(p);
         return GrooveErrorNoMem;
@@ -268,6 +939,10 @@ static int open_audio_device(struct GroovePlayerPrivate *p) {
 
     assert(p->audio_buf);
     p->device_format = p->audio_buf->format;
+    if (p->use_direct_render) {
+        p->device_format.format = p->direct_format;
+        p->device_format.is_planar = 0;
+    }
 
     p->outstream->format = p->device_format.format;
     p->outstream->sample_rate = p->device_format.sample_rate;
@@ -278,12 +953,12 @@ static int open_audio_device(struct GroovePlayerPrivate *p) {
     p->outstream->underflow_callback = underflow_callback;
     p->outstream->write_callback = audio_callback;
 
-    p->outstream->software_latency = 0.025;
+    p->outstream->software_latency = p->target_latency;
 
     p->outstream->name = player->name;
 
-    p->prebuffering = true;
-    if ((err = soundio_outstream_open(p->outstream))) {
+    GROOVE_ATOMIC_STORE(p->prebuffering, true);
+    if ((err = p->outstream_ops->open(p->outstream))) {
         close_audio_device(p);
         av_log(NULL, AV_LOG_ERROR, "unable to open audio device: %s\n", soundio_strerror(err));
         return GrooveErrorOpeningDevice;
@@ -291,12 +966,20 @@ static int open_audio_device(struct GroovePlayerPrivate *p) {
 
     p->device_buffer_frames = ceil(p->outstream->software_latency * (double)p->outstream->sample_rate);
 
-    static const double total_buffer_duration = 2.0;
-    double sink_buffer_seconds = groove_max_double(p->outstream->software_latency * 2.0,
-            total_buffer_duration - p->outstream->software_latency);
-
-    int buffer_size_bytes = sink_buffer_seconds * p->outstream->sample_rate * p->outstream->bytes_per_frame;
-    groove_sink_set_buffer_size_bytes(p->sink, buffer_size_bytes);
+    double latency = p->outstream->software_latency;
+    p->buffer_target_max = groove_max_double(latency * 2.0, p->buffer_duration - latency);
+    p->buffer_target_min = groove_min_double(p->buffer_target_max,
+            groove_max_double(latency * 2.0, p->min_buffer_duration - latency));
+    // an adaptive buffer keeps what it has learned across re-opens
+    double target = GROOVE_ATOMIC_LOAD(p->buffer_target);
+    if (!p->use_adaptive_buffering)
+        target = p->buffer_target_max;
+    else if (target <= 0.0)
+        target = p->buffer_target_min;
+    p->buffer_running_low = false;
+    p->buffer_filled = false;
+    set_buffer_target(p, groove_max_double(p->buffer_target_min,
+                groove_min_double(target, p->buffer_target_max)));
 
     return 0;
 }
@@ -305,126 +988,189 @@ static void helper_thread_run(void *arg) {
     struct GroovePlayerPrivate *p = (struct GroovePlayerPrivate *) arg;
     int err;
 
+    groove_trace_thread_name("player helper");
+
     // This thread's job is to:
     // * Close and re-open the sound device with proper parameters.
     // * Start the outstream when the sink is full.
+    // * Hand buffers to the audio callback and unref the ones it is done
+    //   with, so that the callback never touches the sink or frees memory.
 
-    groove_os_mutex_lock(p->play_head_mutex);
+    groove_os_mutex_lock(p->helper_mutex);
     while (!p->abort_request) {
-        if (p->request_device_close && p->silence_frames_left <= 0) {
+        GROOVE_ATOMIC_STORE(p->helper_wake_pending, false);
+        dispatch_callback_events(p);
+        // anything could have happened while the mutex was let go
+        if (apply_buffer_target(p))
+            continue;
+
+        if (GROOVE_ATOMIC_LOAD(p->request_device_close) && GROOVE_ATOMIC_LOAD(p->silence_played)) {
             close_audio_device(p);
-            emit_event(p->eventq, GROOVE_EVENT_DEVICE_CLOSED);
-            p->request_device_close = false;
-            p->prebuffering = true;
+            emit_helper_event(p, GROOVE_EVENT_DEVICE_CLOSED);
+            GROOVE_ATOMIC_STORE(p->request_device_close, false);
+            GROOVE_ATOMIC_STORE(p->prebuffering, true);
         }
 
-        if (!p->audio_buf) {
-            int ret = groove_sink_buffer_get(p->sink, &p->audio_buf, 0);
-            if (ret != GROOVE_BUFFER_YES) {
-                groove_os_cond_wait(p->helper_thread_cond, p->play_head_mutex);
-                continue;
-            }
+        release_spent_buffers(p);
+        fill_buffer_ring(p);
+        if (p->outstream)
+            adapt_buffer_target(p);
+
+        if (!p->outstream && !load_first_buffer(p)) {
+            wait_for_wakeup(p);
+            continue;
         }
 
-        bool done_prebuffering = p->prebuffering && (groove_sink_contains_end_of_playlist(p->sink) ||
-            groove_sink_get_fill_level(p->sink) >= p->sink->buffer_size_bytes);
+        bool done_prebuffering = GROOVE_ATOMIC_LOAD(p->prebuffering) &&
+            (GROOVE_ATOMIC_LOAD(p->ring_contains_end) ||
+             groove_sink_contains_end_of_playlist(p->sink) || groove_sink_is_full(p->sink) ||
+             (p->outstream && buffered_seconds(p) >= p->prebuffer_duration));
 
-        if ((p->request_device_open && p->silence_frames_left <= 0) || (!p->outstream && done_prebuffering)) {
-            p->request_device_open = false;
+        if ((GROOVE_ATOMIC_LOAD(p->request_device_open) && GROOVE_ATOMIC_LOAD(p->silence_played)) ||
+            (!p->outstream && done_prebuffering))
+        {
+            GROOVE_ATOMIC_STORE(p->request_device_open, false);
             p->is_started = false;
             if ((err = open_audio_device(p))) {
-                emit_event(p->eventq, GROOVE_EVENT_DEVICE_OPEN_ERROR);
-                groove_os_mutex_unlock(p->play_head_mutex);
+                emit_helper_event(p, GROOVE_EVENT_DEVICE_OPEN_ERROR);
+                groove_os_mutex_unlock(p->helper_mutex);
                 return;
             }
-            emit_event(p->eventq, GROOVE_EVENT_DEVICE_OPENED);
+            emit_helper_event(p, GROOVE_EVENT_DEVICE_OPENED);
         }
 
         if (done_prebuffering) {
-            p->prebuffering = false;
+            GROOVE_ATOMIC_STORE(p->prebuffering, false);
             if (!p->is_started) {
                 p->is_started = true;
-                groove_os_mutex_unlock(p->play_head_mutex);
-                if ((err = soundio_outstream_start(p->outstream))) {
+                groove_os_mutex_unlock(p->helper_mutex);
+                err = p->outstream_ops->start(p->outstream);
+                groove_os_mutex_lock(p->helper_mutex);
+                if (err) {
                     av_log(NULL, AV_LOG_ERROR, "unable to start playback stream: %s\n", soundio_strerror(err));
-                    emit_event(p->eventq, GROOVE_EVENT_DEVICE_OPEN_ERROR);
-                    groove_os_mutex_unlock(p->play_head_mutex);
+                    emit_helper_event(p, GROOVE_EVENT_DEVICE_OPEN_ERROR);
+                    groove_os_mutex_unlock(p->helper_mutex);
                     return;
                 }
-                groove_os_mutex_lock(p->play_head_mutex);
             }
-            soundio_outstream_pause(p->outstream, p->is_paused);
+            p->outstream_ops->pause(p->outstream, GROOVE_ATOMIC_LOAD(p->is_paused));
             continue;
         }
 
-        groove_os_cond_wait(p->helper_thread_cond, p->play_head_mutex);
-        continue;
+        if (GROOVE_ATOMIC_LOAD(p->helper_wake_pending))
+            continue;
+
+        wait_for_wakeup(p);
     }
-    groove_os_mutex_unlock(p->play_head_mutex);
+    groove_os_mutex_unlock(p->helper_mutex);
 
     close_audio_device(p);
 }
 
+// drops every buffer of item that has not reached the device yet
+static void purge_buffer_ring(struct GroovePlayerPrivate *p, struct GroovePlaylistItem *item) {
+    void *objs[RING_CAPACITY];
+    int count = 0;
+    while (groove_ring_pop(p->buffer_ring, &objs[count]))
+        count += 1;
+    for (int i = 0; i < count; i += 1) {
+        struct GrooveBuffer *buffer = (struct GrooveBuffer *)objs[i];
+        if (buffer && buffer->item == item)
+            unref_ring_buffer(p, buffer);
+        else
+            groove_ring_push(p->buffer_ring, buffer);
+    }
+}
+
 static void sink_purge(struct GrooveSink *sink, struct GroovePlaylistItem *item) {
     struct GroovePlayerPrivate *p = (struct GroovePlayerPrivate *)sink->userdata;
 
-    groove_os_mutex_lock(p->play_head_mutex);
+    // holding the mutex keeps the helper thread from pushing, so with the
+    // callback state this thread is both ends of buffer_ring
+    groove_os_mutex_lock(p->helper_mutex);
+
+    // the callback only ever has buffers the helper thread gave it, and the
+    // play head is the item of the last one it started. if neither is
+    // anything of item, leave the callback alone so that it does not play
+    // a period of silence for nothing.
+    if (!item_is_outstanding(p, item) && p->last_spent_item != item) {
+        groove_os_mutex_unlock(p->helper_mutex);
+        return;
+    }
+
+    acquire_callback_state(p);
+
+    purge_buffer_ring(p, item);
+    if (p->audio_buf && p->audio_buf->item == item)
+        drop_audio_buf(p);
 
     if (p->play_head == item) {
         p->play_head = NULL;
         p->play_pos = -1.0;
-        groove_buffer_unref(p->audio_buf);
-        p->audio_buf = NULL;
-        p->audio_buf_index = 0;
-        p->audio_buf_size = 0;
-        emit_event(p->eventq, GROOVE_EVENT_NOWPLAYING);
+        drop_audio_buf(p);
+        publish_position(p, false);
+        // after any NOWPLAYING the callback emitted for item
+        emit_helper_event(p, GROOVE_EVENT_NOWPLAYING);
     }
+    if (p->last_spent_item == item)
+        p->last_spent_item = NULL;
 
-    groove_os_mutex_unlock(p->play_head_mutex);
+    release_callback_state(p);
+    groove_os_sem_post(p->helper_sem);
+    groove_os_mutex_unlock(p->helper_mutex);
 }
 
 static void sink_pause(struct GrooveSink *sink) {
     struct GroovePlayer *player = (struct GroovePlayer *)sink->userdata;
     struct GroovePlayerPrivate *p = (struct GroovePlayerPrivate *) player;
 
-    groove_os_mutex_lock(p->play_head_mutex);
+    groove_os_mutex_lock(p->helper_mutex);
     set_pause_state(p, true);
-    groove_os_mutex_unlock(p->play_head_mutex);
+    groove_os_mutex_unlock(p->helper_mutex);
 }
 
 static void sink_play(struct GrooveSink *sink) {
     struct GroovePlayer *player = (struct GroovePlayer *)sink->userdata;
     struct GroovePlayerPrivate *p = (struct GroovePlayerPrivate *) player;
 
-    groove_os_mutex_lock(p->play_head_mutex);
+    groove_os_mutex_lock(p->helper_mutex);
     set_pause_state(p, false);
-    groove_os_mutex_unlock(p->play_head_mutex);
+    groove_os_sem_post(p->helper_sem);
+    groove_os_mutex_unlock(p->helper_mutex);
 }
 
 static void sink_filled(struct GrooveSink *sink) {
     struct GroovePlayerPrivate *p = (struct GroovePlayerPrivate *) sink->userdata;
 
-    groove_os_mutex_lock(p->play_head_mutex);
-    groove_os_cond_signal(p->helper_thread_cond, p->play_head_mutex);
-    groove_os_mutex_unlock(p->play_head_mutex);
+    groove_os_sem_post(p->helper_sem);
 }
 
 static void sink_flush(struct GrooveSink *sink) {
     struct GroovePlayerPrivate *p = (struct GroovePlayerPrivate *)sink->userdata;
 
-    groove_os_mutex_lock(p->play_head_mutex);
+    groove_os_mutex_lock(p->helper_mutex);
+    acquire_callback_state(p);
 
-    groove_buffer_unref(p->audio_buf);
-    p->audio_buf = NULL;
-    p->audio_buf_index = 0;
-    p->audio_buf_size = 0;
+    void *obj;
+    while (groove_ring_pop(p->buffer_ring, &obj)) {
+        if (obj)
+            unref_ring_buffer(p, (struct GrooveBuffer *)obj);
+    }
+    GROOVE_ATOMIC_STORE(p->ring_contains_end, false);
+    drop_audio_buf(p);
     p->play_pos = -1.0;
     p->play_head = NULL;
-    p->prebuffering = true;
+    p->last_spent_item = NULL;
+    publish_position(p, false);
+    GROOVE_ATOMIC_STORE(p->prebuffering, true);
+
+    release_callback_state(p);
+
     if (p->outstream)
-        soundio_outstream_clear_buffer(p->outstream);
+        p->outstream_ops->clear_buffer(p->outstream);
 
-    groove_os_mutex_unlock(p->play_head_mutex);
+    groove_os_sem_post(p->helper_sem);
+    groove_os_mutex_unlock(p->helper_mutex);
 }
 
 struct GroovePlayer *groove_player_create(struct Groove *groove) {
@@ -449,9 +1195,17 @@ struct GroovePlayer *groove_player_create(struct Groove *groove) {
     p->sink->purge = sink_purge;
     p->sink->flush = sink_flush;
 
-    if (!(p->play_head_mutex = groove_os_mutex_create())) {
+    if (!(p->helper_mutex = groove_os_mutex_create())) {
+        groove_player_destroy(player);
+        av_log(NULL, AV_LOG_ERROR,"unable to create helper mutex: out of memory\n");
+        return NULL;
+    }
+
+    if (!(p->buffer_ring = groove_ring_create(RING_CAPACITY)) ||
+        !(p->spent_ring = groove_ring_create(RING_CAPACITY)))
+    {
         groove_player_destroy(player);
-        av_log(NULL, AV_LOG_ERROR,"unable to create play head mutex: out of memory\n");
+        av_log(NULL, AV_LOG_ERROR,"unable to create buffer rings: out of memory\n");
         return NULL;
     }
 
@@ -462,15 +1216,21 @@ struct GroovePlayer *groove_player_create(struct Groove *groove) {
         return NULL;
     }
 
-    if (!(p->helper_thread_cond = groove_os_cond_create())) {
+    if (!(p->helper_sem = groove_os_sem_create())) {
         groove_player_destroy(player);
-        av_log(NULL, AV_LOG_ERROR, "unable to create mutex condition\n");
+        av_log(NULL, AV_LOG_ERROR, "unable to create semaphore\n");
         return NULL;
     }
 
     // set some nice defaults
     player->gain = p->sink->gain;
     player->name = "libgroove";
+    player->target_latency = 0.025;
+    player->buffer_duration = 2.0;
+    player->prebuffer_duration = 2.0;
+    player->min_buffer_duration = 0.5;
+    player->fixed_sample_rate = 44100;
+    player->virtual_speed = 1.0;
 
     return player;
 }
@@ -481,8 +1241,10 @@ void groove_player_destroy(struct GroovePlayer *player) {
 
     struct GroovePlayerPrivate *p = (struct GroovePlayerPrivate *) player;
 
-    groove_os_cond_destroy(p->helper_thread_cond);
-    groove_os_mutex_destroy(p->play_head_mutex);
+    groove_os_sem_destroy(p->helper_sem);
+    groove_os_mutex_destroy(p->helper_mutex);
+    groove_ring_destroy(p->buffer_ring);
+    groove_ring_destroy(p->spent_ring);
 
     if (p->eventq)
         groove_queue_destroy(p->eventq);
@@ -515,48 +1277,221 @@ static enum SoundIoFormat best_supported_format(struct SoundIoDevice *device) {
     return SoundIoFormatInvalid;
 }
 
+// restricts the sink to what the sound card can play
+// the device is opened with the sample format the sink would otherwise have
+// used, and the sink gets float for the audio callback to convert
+static void set_direct_render_formats(struct GroovePlayerPrivate *p) {
+    p->direct_format = p->sink->sample_format_default;
+    p->sink->sample_format_default = SoundIoFormatFloat32NE;
+    p->sink->sample_formats = &p->sink->sample_format_default;
+    p->sink->sample_format_count = 1;
+}
+
+static int attach_device_formats(struct GroovePlayerPrivate *p) {
+    struct GroovePlayer *player = &p->externals;
+    struct SoundIoDevice *device = player->device;
+    int err;
+
+    soundio_device_ref(device);
+    p->outstream_ops = &soundio_outstream_ops;
+
+    if (device->software_latency_min > 0.0)
+        p->target_latency = groove_max_double(p->target_latency, device->software_latency_min);
+    if (device->software_latency_max > 0.0)
+        p->target_latency = groove_min_double(p->target_latency, device->software_latency_max);
+
+    p->sink->sample_rates = device->sample_rates;
+    p->sink->sample_rate_count = device->sample_rate_count;
+    p->sink->sample_rate_default = soundio_device_nearest_sample_rate(device, 44100);
+
+    p->sink->channel_layouts = device->layouts;
+    p->sink->channel_layout_count = device->layout_count;
+    if ((err = best_supported_layout(device, &p->sink->channel_layout_default)))
+        return err;
+
+    p->sink->sample_formats = device->formats;
+    p->sink->sample_format_count = device->format_count;
+    p->sink->sample_format_default = best_supported_format(device);
+
+    if (p->sink->sample_format_default == SoundIoFormatInvalid)
+        return GrooveErrorDeviceParams;
+
+    if (p->use_direct_render)
+        set_direct_render_formats(p);
+
+    if (p->use_fixed_format) {
+        struct GrooveAudioFormat fixed_format;
+        fixed_format.sample_rate = soundio_device_nearest_sample_rate(device,
+                player->fixed_sample_rate);
+        fixed_format.layout = p->sink->channel_layout_default;
+        fixed_format.format = p->sink->sample_format_default;
+        fixed_format.is_planar = 0;
+        groove_sink_set_only_format(p->sink, &fixed_format);
+    }
+
+    return 0;
+}
+
+static void follower_error(void *userdata, int err) {
+    struct GroovePlayerPrivate *p = (struct GroovePlayerPrivate *)userdata;
+    (void)err;
+    emit_callback_event(p, GROOVE_EVENT_STREAM_ERROR);
+}
+
+// opens every extra device, to play the fixed format the sink was given
+static int create_followers(struct GroovePlayerPrivate *p) {
+    struct GroovePlayer *player = &p->externals;
+    int err;
+
+    struct GrooveAudioFormat source_format;
+    source_format.sample_rate = p->sink->sample_rate_default;
+    source_format.layout = p->sink->channel_layout_default;
+    source_format.format = p->sink->sample_format_default;
+    source_format.is_planar = 0;
+
+    p->followers = ALLOCATE(struct GrooveFollower *, player->extra_device_count);
+    if (!p->followers)
+        return GrooveErrorNoMem;
+
+    double ring_seconds = groove_max_double(0.5, p->target_latency * 8.0);
+    for (int i = 0; i < player->extra_device_count; i += 1) {
+        struct SoundIoDevice *device = player->extra_devices[i];
+
+        if (!soundio_device_supports_layout(device, &source_format.layout))
+            return GrooveErrorDeviceParams;
+
+        struct GrooveAudioFormat device_format = source_format;
+        device_format.sample_rate = soundio_device_nearest_sample_rate(device,
+                source_format.sample_rate);
+        if (!soundio_device_supports_format(device, source_format.format))
+            device_format.format = best_supported_format(device);
+
+        // a smaller buffer than the player's device leaves room in the
+        // follower to line the two up
+        double latency = p->target_latency / 2.0;
+        if (device->software_latency_min > 0.0)
+            latency = groove_max_double(latency, device->software_latency_min);
+        if (device->software_latency_max > 0.0)
+            latency = groove_min_double(latency, device->software_latency_max);
+
+        if ((err = groove_follower_create(device, &source_format, &device_format, latency,
+                        ring_seconds, follower_error, p, &p->followers[i])))
+        {
+            return err;
+        }
+        p->follower_count += 1;
+    }
+
+    for (int i = 0; i < p->follower_count; i += 1) {
+        if ((err = groove_follower_start(p->followers[i])))
+            return err;
+    }
+
+    return 0;
+}
+
 int groove_player_attach(struct GroovePlayer *player, struct GroovePlaylist *playlist) {
     struct GroovePlayerPrivate *p = (struct GroovePlayerPrivate *) player;
     int err;
 
-    if (!player->device)
+    if (player->use_virtual_device) {
+        if (!(player->virtual_speed > 0.0))
+            return GrooveErrorInvalid;
+        if ((player->use_fixed_format || player->extra_device_count > 0) &&
+            player->fixed_sample_rate <= 0)
+        {
+            return GrooveErrorInvalid;
+        }
+    } else {
+        if (!player->device)
+            return GrooveErrorInvalid;
+        if (player->device->aim != SoundIoDeviceAimOutput)
+            return GrooveErrorInvalid;
+    }
+    if (!(player->target_latency > 0.0) || player->buffer_duration < 0.0 ||
+        player->prebuffer_duration < 0.0 || player->min_buffer_duration < 0.0)
+    {
         return GrooveErrorInvalid;
-    if (player->device->aim != SoundIoDeviceAimOutput)
+    }
+    if (player->extra_device_count < 0 ||
+        (player->extra_device_count > 0 && !player->extra_devices))
+    {
         return GrooveErrorInvalid;
+    }
+    // followers are handed the bytes the audio callback writes, which only
+    // exist in the device format when it copies rather than converts
+    if (player->use_direct_render && player->extra_device_count > 0)
+        return GrooveErrorInvalid;
+    for (int i = 0; i < player->extra_device_count; i += 1) {
+        struct SoundIoDevice *device = player->extra_devices[i];
+        if (!device || device->aim != SoundIoDeviceAimOutput)
+            return GrooveErrorInvalid;
+    }
 
-    soundio_device_ref(player->device);
-
-    p->sink->gain = player->gain;
+    p->use_virtual_device = player->use_virtual_device;
+    p->virtual_speed = player->virtual_speed;
+    p->target_latency = player->target_latency;
+    p->buffer_duration = player->buffer_duration;
+    p->prebuffer_duration = player->prebuffer_duration;
+    p->use_adaptive_buffering = player->use_adaptive_buffering;
+    p->min_buffer_duration = player->min_buffer_duration;
+    GROOVE_ATOMIC_STORE(p->buffer_target, 0.0);
+    p->buffer_target_dirty = false;
+    // every device has to be opened in one format up front for the extra
+    // devices to follow the main one
+    p->use_fixed_format = player->use_fixed_format || player->extra_device_count > 0;
+    p->use_direct_render = player->use_direct_render;
+    GROOVE_ATOMIC_STORE(p->direct_gain, player->gain);
+
+    // with direct render, gain is left to the audio callback
+    p->sink->gain = p->use_direct_render ? 1.0 : player->gain;
     p->sink->pause = sink_pause;
     p->sink->play = sink_play;
     p->sink->filled = sink_filled;
+    p->sink->flags = ((uint32_t)GrooveSinkFlagPlanarOk)|((uint32_t)GrooveSinkFlagInterleavedOk);
 
-    p->sink->sample_rates = player->device->sample_rates;
-    p->sink->sample_rate_count = player->device->sample_rate_count;
-    p->sink->sample_rate_default = soundio_device_nearest_sample_rate(player->device, 44100);
-
-    p->sink->channel_layouts = player->device->layouts;
-    p->sink->channel_layout_count = player->device->layout_count;
-    if ((err = best_supported_layout(player->device, &p->sink->channel_layout_default))) {
+    if (p->use_virtual_device) {
+        p->outstream_ops = &virtual_outstream_ops;
+        groove_virtual_device_counters_reset(&p->virtual_counters);
+
+        // the virtual device plays any format, so the playlist never has to
+        // convert
+        p->sink->sample_rates = NULL;
+        p->sink->sample_rate_count = 0;
+        p->sink->sample_rate_default = 44100;
+        p->sink->channel_layouts = NULL;
+        p->sink->channel_layout_count = 0;
+        p->sink->channel_layout_default =
+            *soundio_channel_layout_get_builtin(SoundIoChannelLayoutIdStereo);
+        p->sink->sample_formats = NULL;
+        p->sink->sample_format_count = 0;
+        p->sink->sample_format_default = SoundIoFormatFloat32NE;
+        if (p->use_direct_render)
+            set_direct_render_formats(p);
+
+        if (p->use_fixed_format) {
+            struct GrooveAudioFormat fixed_format;
+            fixed_format.sample_rate = player->fixed_sample_rate;
+            fixed_format.layout = p->sink->channel_layout_default;
+            fixed_format.format = p->sink->sample_format_default;
+            fixed_format.is_planar = 0;
+            groove_sink_set_only_format(p->sink, &fixed_format);
+        }
+    } else if ((err = attach_device_formats(p))) {
         groove_player_detach(player);
         return err;
     }
 
-    p->sink->sample_formats = player->device->formats;
-    p->sink->sample_format_count = player->device->format_count;
-    p->sink->sample_format_default = best_supported_format(player->device);
-
-    if (p->sink->sample_format_default == SoundIoFormatInvalid) {
+    if (player->extra_device_count > 0 && (err = create_followers(p))) {
         groove_player_detach(player);
-        return GrooveErrorDeviceParams;
+        return err;
     }
 
-    p->sink->flags = ((uint32_t)GrooveSinkFlagPlanarOk)|((uint32_t)GrooveSinkFlagInterleavedOk);
-
     // This is set later when the device is opened.
     // Set to 1 means that it will get exactly one buffer and then consider itself full until
-    // we update the buffer size bytes field.
+    // we update the buffer size seconds field.
     p->sink->buffer_size_bytes = 1;
+    p->sink->buffer_size_seconds = 0.0;
 
     if ((err = groove_sink_attach(p->sink, playlist))) {
         groove_player_detach(player);
@@ -564,14 +1499,24 @@ int groove_player_attach(struct GroovePlayer *player, struct GroovePlaylist *pla
         return err;
     }
 
+    p->play_head = NULL;
     p->play_pos = -1.0;
-    p->request_device_open = true;
+    p->play_pos_adjustment = 0.0;
+    p->last_spent_item = NULL;
+    publish_position(p, false);
+    GROOVE_ATOMIC_STORE(p->request_device_open, true);
+    GROOVE_ATOMIC_STORE(p->request_device_close, false);
+    GROOVE_ATOMIC_STORE(p->silence_played, true);
+    GROOVE_ATOMIC_STORE(p->prebuffering, false);
+    GROOVE_ATOMIC_STORE(p->callback_lock, false);
+    GROOVE_ATOMIC_STORE(p->helper_wake_pending, false);
     p->audio_buf_size = 0;
     p->audio_buf_index = 0;
     p->abort_request = false;
     p->silence_frames_left = 0;
 
     groove_queue_reset(p->eventq);
+    reset_event_ring(p);
 
     assert(!p->outstream);
 
@@ -590,13 +1535,21 @@ int groove_player_detach(struct GroovePlayer *player) {
     struct GroovePlayerPrivate *p = (struct GroovePlayerPrivate *) player;
 
     if (p->helper_thread) {
-        groove_os_mutex_lock(p->play_head_mutex);
+        groove_os_mutex_lock(p->helper_mutex);
         p->abort_request = true;
-        groove_os_cond_signal(p->helper_thread_cond, p->play_head_mutex);
-        groove_os_mutex_unlock(p->play_head_mutex);
+        groove_os_sem_post(p->helper_sem);
+        groove_os_mutex_unlock(p->helper_mutex);
         groove_os_thread_destroy(p->helper_thread);
+        p->helper_thread = NULL;
     }
 
+    // the device is closed, so nothing feeds the followers any more
+    for (int i = 0; i < p->follower_count; i += 1)
+        groove_follower_destroy(p->followers[i]);
+    DEALLOCATE(p->followers);
+    p->followers = NULL;
+    p->follower_count = 0;
+
     if (p->eventq) {
         groove_queue_flush(p->eventq);
         groove_queue_abort(p->eventq);
@@ -607,11 +1560,20 @@ int groove_player_detach(struct GroovePlayer *player) {
 
     player->playlist = NULL;
 
-    soundio_device_unref(player->device);
-    player->device = NULL;
+    if (!p->use_virtual_device) {
+        soundio_device_unref(player->device);
+        player->device = NULL;
+    }
 
-    groove_buffer_unref(p->audio_buf);
-    p->audio_buf = NULL;
+    // the device is closed, so this thread is both ends of both rings
+    release_spent_buffers(p);
+    void *obj;
+    while (groove_ring_pop(p->buffer_ring, &obj)) {
+        if (obj)
+            unref_ring_buffer(p, (struct GrooveBuffer *)obj);
+    }
+    GROOVE_ATOMIC_STORE(p->ring_contains_end, false);
+    drop_audio_buf(p);
 
     p->abort_request = false;
 
@@ -622,24 +1584,21 @@ void groove_player_position(struct GroovePlayer *player,
         struct GroovePlaylistItem **item, double *seconds)
 {
     struct GroovePlayerPrivate *p = (struct GroovePlayerPrivate *) player;
-
-    groove_os_mutex_lock(p->play_head_mutex);
-
-    if (item)
-        *item = p->play_head;
-
-    if (seconds)
-        *seconds = p->play_pos - p->play_pos_adjustment;
-
-    groove_os_mutex_unlock(p->play_head_mutex);
+    read_position(p, groove_os_get_time(), item, seconds);
 }
 
 int groove_player_event_get(struct GroovePlayer *player,
         union GroovePlayerEvent *event, int block)
+{
+    return groove_player_event_get_timeout(player, event, block ? -1.0 : 0.0);
+}
+
+int groove_player_event_get_timeout(struct GroovePlayer *player,
+        union GroovePlayerEvent *event, double seconds)
 {
     struct GroovePlayerPrivate *p = (struct GroovePlayerPrivate *) player;
     union GroovePlayerEvent *tmp;
-    int err = groove_queue_get(p->eventq, (void **)&tmp, block);
+    int err = groove_queue_get_timeout(p->eventq, (void **)&tmp, seconds);
     if (err > 0) {
         *event = *tmp;
         DEALLOCATE(tmp);
@@ -652,17 +1611,90 @@ int groove_player_event_peek(struct GroovePlayer *player, int block) {
     return groove_queue_peek(p->eventq, block);
 }
 
+int groove_player_event_get_fd(struct GroovePlayer *player) {
+    struct GroovePlayerPrivate *p = (struct GroovePlayerPrivate *) player;
+    return groove_queue_get_fd(p->eventq);
+}
+
+double groove_player_get_buffer_duration(struct GroovePlayer *player) {
+    struct GroovePlayerPrivate *p = (struct GroovePlayerPrivate *) player;
+    return GROOVE_ATOMIC_LOAD(p->buffer_target);
+}
+
+void groove_player_get_stats(struct GroovePlayer *player, struct GrooveSinkStats *stats) {
+    struct GroovePlayerPrivate *p = (struct GroovePlayerPrivate *) player;
+    groove_sink_get_stats(p->sink, stats);
+}
+
 int groove_player_set_gain(struct GroovePlayer *player, double gain) {
     struct GroovePlayerPrivate *p = (struct GroovePlayerPrivate *) player;
     player->gain = gain;
+    if (p->use_direct_render) {
+        GROOVE_ATOMIC_STORE(p->direct_gain, gain);
+        return 0;
+    }
     return groove_sink_set_gain(p->sink, gain);
 }
 
+int groove_player_reopen_device(struct GroovePlayer *player) {
+    struct GroovePlayerPrivate *p = (struct GroovePlayerPrivate *) player;
+
+    if (!p->sink->playlist)
+        return GrooveErrorInvalid;
+
+    groove_os_mutex_lock(p->helper_mutex);
+
+    // there is no need to fade out through silence first as there is for a
+    // format change; the caller asked for the interruption
+    acquire_callback_state(p);
+    p->silence_frames_left = 0;
+    GROOVE_ATOMIC_STORE(p->silence_played, true);
+    release_callback_state(p);
+
+    if (p->outstream)
+        GROOVE_ATOMIC_STORE(p->request_device_close, true);
+    GROOVE_ATOMIC_STORE(p->request_device_open, true);
+
+    groove_os_sem_post(p->helper_sem);
+    groove_os_mutex_unlock(p->helper_mutex);
+    return 0;
+}
+
+int groove_player_get_extra_device_stats(struct GroovePlayer *player, int index,
+        struct GrooveExtraDeviceStats *stats)
+{
+    struct GroovePlayerPrivate *p = (struct GroovePlayerPrivate *) player;
+    if (index < 0 || index >= p->follower_count)
+        return GrooveErrorInvalid;
+    groove_follower_get_stats(p->followers[index], stats);
+    return 0;
+}
+
+int groove_player_get_virtual_device_stats(struct GroovePlayer *player,
+        struct GrooveVirtualDeviceStats *stats)
+{
+    struct GroovePlayerPrivate *p = (struct GroovePlayerPrivate *) player;
+    struct GrooveVirtualDeviceCounters *c = &p->virtual_counters;
+
+    if (!p->use_virtual_device)
+        return GrooveErrorInvalid;
+
+    stats->callback_count = GROOVE_ATOMIC_LOAD_RELAXED(c->callback_count);
+    stats->callback_seconds = GROOVE_ATOMIC_LOAD_RELAXED(c->callback_ns) / 1000000000.0;
+    stats->callback_max_seconds = GROOVE_ATOMIC_LOAD_RELAXED(c->callback_max_ns) / 1000000000.0;
+    stats->lateness_seconds = GROOVE_ATOMIC_LOAD_RELAXED(c->lateness_ns) / 1000000000.0;
+    stats->lateness_max_seconds = GROOVE_ATOMIC_LOAD_RELAXED(c->lateness_max_ns) / 1000000000.0;
+    stats->underrun_count = GROOVE_ATOMIC_LOAD_RELAXED(c->underrun_count);
+    stats->frames_played = GROOVE_ATOMIC_LOAD_RELAXED(c->frames_played);
+    stats->drift_seconds = GROOVE_ATOMIC_LOAD_RELAXED(c->drift_ns) / 1000000000.0;
+    return 0;
+}
+
 void groove_player_get_device_audio_format(struct GroovePlayer *player,
         struct GrooveAudioFormat *out_audio_format)
 {
     struct GroovePlayerPrivate *p = (struct GroovePlayerPrivate *) player;
-    groove_os_mutex_lock(p->play_head_mutex);
+    groove_os_mutex_lock(p->helper_mutex);
     *out_audio_format = p->device_format;
-    groove_os_mutex_unlock(p->play_head_mutex);
+    groove_os_mutex_unlock(p->helper_mutex);
 }
@@ -6,10 +6,14 @@
  */
 
 #include "file.h"
+#include "groove_private.h"
 #include "queue.h"
 #include "buffer.h"
 #include "util.h"
 #include "atomics.h"
+#include "os.h"
+#include "trace.h"
+#include "probes.h"
 
 #define __STDC_FORMAT_MACROS
 #include <pthread.h>
@@ -25,9 +29,33 @@ struct GrooveSinkPrivate {
     struct Groove *groove;
     struct GrooveQueue *audioq;
     struct GrooveAtomicInt audioq_size; // in bytes
+    struct GrooveAtomicLongLong audioq_duration; // in microseconds
+    // the sink is full at min_audioq_size; once full, the decode thread is
+    // not woken up again until the sink drains below low_audioq_size.
+    // when the sink is sized by duration, the *_duration fields are nonzero
+    // and are used instead.
     int min_audioq_size; // in bytes
+    int low_audioq_size; // in bytes
+    int64_t min_audioq_duration; // in microseconds
+    int64_t low_audioq_duration; // in microseconds
     struct GrooveAtomicBool audioq_contains_end;
     struct SoundIoSampleRateRange prealloc_sample_rate_range;
+    struct GrooveAtomicLong decode_sleep_count;
+};
+
+// playlist items are carved out of chunks of this many items at a time
+#define ITEM_CHUNK_SIZE 64
+
+struct GroovePlaylistItemPrivate {
+    struct GroovePlaylistItem externals;
+    // index of this item across all of the playlist's item chunks
+    uint32_t slot;
+    // incremented every time the slot is released so that handles to a
+    // removed item can be told apart from handles to the slot's next tenant
+    uint32_t generation;
+    bool in_use;
+    // when not in use, the next item in the free list
+    struct GroovePlaylistItemPrivate *next_free;
 };
 
 struct SinkStack {
@@ -102,15 +130,50 @@ struct GroovePlaylistPrivate {
     // only touched by decode_thread, tells whether we have sent the end_of_q_sentinel
     int sent_end_of_q;
 
+    // every buffer decoded by this playlist is charged here
+    struct GrooveBufferAccount *account;
+
+    // true while decode_thread is checking for or waiting on full sinks.
+    // consumers only need to signal sink_drain_cond when this is set.
+    struct GrooveAtomicBool decode_waiting;
+
     struct GroovePlaylistItem *purge_item; // set temporarily
 
     int (*detect_full_sinks)(struct GroovePlaylist*);
+
+    // decode thread statistics, protected by decode_head_mutex
+    struct GroovePlaylistStats stats;
+    // time spent in the pipeline stages on the item being decoded
+    double item_busy_seconds;
+    struct GroovePlaylistItem *stats_item;
+    // when groove_playlist_seek was last called, or 0 once the decode
+    // thread has acted on it. protected by decode_head_mutex.
+    double seek_request_time;
+
+    // playlist items are allocated from these chunks, which are only freed
+    // when the playlist is destroyed. protected by decode_head_mutex.
+    struct GroovePlaylistItemPrivate **item_chunks;
+    int item_chunk_count;
+    struct GroovePlaylistItemPrivate *item_free_list;
 };
 
 // this is used to tell the difference between a buffer underrun
 // and the end of the playlist.
 static struct GrooveBuffer *end_of_q_sentinel = NULL;
 
+// in microseconds. 64-bit, since a long overflows past 2147 frames on
+// 32-bit and LLP64 targets.
+static int64_t buffer_duration(const struct GrooveBuffer *buffer) {
+    return ((int64_t)buffer->frame_count * 1000000) / buffer->format.sample_rate;
+}
+
+// in microseconds, clamped so that adding a few of them up cannot overflow
+static int64_t seconds_to_us(double seconds) {
+    if (!(seconds > 0.0))
+        return 0;
+    return (seconds < 1e12) ? (int64_t)(seconds * 1000000.0) : INT64_C(1000000000000000000);
+}
+
 static int frame_size(const AVFrame *frame) {
     return av_get_channel_layout_nb_channels(frame->channel_layout) *
         av_get_bytes_per_sample((enum AVSampleFormat)frame->format) * frame->nb_samples;
@@ -150,10 +213,24 @@ static struct GrooveBuffer *frame_to_groove_buffer(struct GroovePlaylist *playli
 
     b->frame = frame;
 
+    groove_buffer_charge(buffer, p->account);
+
     return buffer;
 }
 
 
+// charges the time since *start to stage and restarts *start from now.
+// must be called with decode_head_mutex held.
+static void stage_lap(struct GroovePlaylistPrivate *p, struct GroovePipelineStageStats *stage,
+        double *start)
+{
+    double now = groove_os_get_time();
+    double elapsed = now - *start;
+    stage->seconds += elapsed;
+    p->item_busy_seconds += elapsed;
+    *start = now;
+}
+
 // decode one audio packet and return its uncompressed size
 static int audio_decode_frame(struct GroovePlaylist *playlist, struct GrooveFile *file) {
     struct GroovePlaylistPrivate *p = (struct GroovePlaylistPrivate *) playlist;
@@ -178,7 +255,9 @@ static int audio_decode_frame(struct GroovePlaylist *playlist, struct GrooveFile
     while (pkt_temp->size > 0 || (!pkt_temp->data && new_packet)) {
         new_packet = 0;
 
+        double stage_start = groove_os_get_time();
         len1 = avcodec_decode_audio4(dec, in_frame, &got_frame, pkt_temp);
+        stage_lap(p, &p->stats.decode, &stage_start);
         if (len1 < 0) {
             // if error, we skip the frame
             pkt_temp->size = 0;
@@ -195,6 +274,12 @@ static int audio_decode_frame(struct GroovePlaylist *playlist, struct GrooveFile
             continue;
         }
 
+        double frame_seconds = in_frame->nb_samples / (double)in_frame->sample_rate;
+        p->stats.decode.bytes += frame_size(in_frame);
+        p->stats.decode.count += 1;
+        p->stats.audio_seconds += frame_seconds;
+        p->stats.item_audio_seconds += frame_seconds;
+
         // push the audio data from decoded frame into the filtergraph
         int err = av_buffersrc_write_frame(p->abuffer_ctx, in_frame);
         if (err < 0) {
@@ -221,6 +306,7 @@ static int audio_decode_frame(struct GroovePlaylist *playlist, struct GrooveFile
                 int err = example_sink->buffer_sample_count == 0 ?
                     av_buffersink_get_frame(map_item->abuffersink_ctx, oframe) :
                     av_buffersink_get_samples(map_item->abuffersink_ctx, oframe, example_sink->buffer_sample_count);
+                stage_lap(p, &p->stats.filter, &stage_start);
                 if (err == AVERROR_EOF || err == AVERROR(EAGAIN)) {
                     av_frame_free(&oframe);
                     break;
@@ -242,6 +328,10 @@ static int audio_decode_frame(struct GroovePlaylist *playlist, struct GrooveFile
                     clock_adjustment = buffer->size / bytes_per_sec;
                 }
                 data_size += buffer->size;
+                p->stats.filter.bytes += buffer->size;
+                p->stats.filter.count += 1;
+                stage_lap(p, &p->stats.filter, &stage_start);
+                int delivered = 0;
                 struct SinkStack *stack_item = map_item->stack_head;
                 // we hold this reference to avoid cleanups until at least this loop
                 // is done and we call unref after it.
@@ -249,17 +339,26 @@ static int audio_decode_frame(struct GroovePlaylist *playlist, struct GrooveFile
                 while (stack_item) {
                     struct GrooveSink *sink = stack_item->sink;
                     struct GrooveSinkPrivate *s = (struct GrooveSinkPrivate *) sink;
-                    // as soon as we call groove_queue_put, this buffer could be unref'd.
-                    // so we ref before putting it in the queue, and unref if it failed.
-                    groove_buffer_ref(buffer);
-                    if (groove_queue_put(s->audioq, buffer) < 0) {
-                        av_log(NULL, AV_LOG_ERROR, "unable to put buffer in queue\n");
-                        groove_buffer_unref(buffer);
+                    if (sink->push) {
+                        // push sinks borrow the reference we hold for this loop
+                        sink->push(sink, buffer);
+                    } else {
+                        // as soon as we call groove_queue_put, this buffer could be unref'd.
+                        // so we ref before putting it in the queue, and unref if it failed.
+                        groove_buffer_ref(buffer);
+                        if (groove_queue_put(s->audioq, buffer) < 0) {
+                            av_log(NULL, AV_LOG_ERROR, "unable to put buffer in queue\n");
+                            groove_buffer_unref(buffer);
+                        }
+                        if (sink->filled) sink->filled(sink);
                     }
-                    if (sink->filled) sink->filled(sink);
+                    delivered += 1;
                     stack_item = stack_item->next;
                 }
                 groove_buffer_unref(buffer);
+                p->stats.queue.bytes += (int64_t)buffer->size * delivered;
+                p->stats.queue.count += delivered;
+                stage_lap(p, &p->stats.queue, &stage_start);
             }
             max_data_size = groove_max_int(max_data_size, data_size);
             map_item = map_item->next;
@@ -574,7 +673,15 @@ static int maybe_init_filter_graph(struct GroovePlaylist *playlist, struct Groov
         p->volume != p->filter_volume ||
         p->peak != p->filter_peak)
     {
-        return init_filter_graph(playlist, file);
+        double start = groove_os_get_time();
+        GROOVE_TRACE_BEGIN("init_filter_graph");
+        GROOVE_PROBE1(filter_graph_build_enter, playlist);
+        int err = init_filter_graph(playlist, file);
+        GROOVE_PROBE2(filter_graph_build_exit, playlist, err);
+        GROOVE_TRACE_END("init_filter_graph");
+        p->stats.filter_graph_build_count += 1;
+        p->stats.filter_graph_build_seconds += groove_os_get_time() - start;
+        return err;
     }
 
     return 0;
@@ -597,13 +704,74 @@ static int every_sink(struct GroovePlaylist *playlist, int (*func)(struct Groove
     return default_value;
 }
 
+// must be called with decode_head_mutex held if the sink is attached
+static void sink_update_watermarks(struct GrooveSinkPrivate *s) {
+    struct GrooveSink *sink = &s->externals;
+    s->min_audioq_size = sink->buffer_size_bytes;
+    int low = sink->buffer_low_watermark_bytes;
+    if (low <= 0 || low > s->min_audioq_size)
+        low = s->min_audioq_size / 2;
+    // the sink must be able to drain below the low watermark
+    s->low_audioq_size = groove_max_int(low, 1);
+
+    if (sink->buffer_size_seconds > 0.0) {
+        int64_t min_duration = seconds_to_us(sink->buffer_size_seconds);
+        s->min_audioq_duration = (min_duration > 0) ? min_duration : 1;
+        int64_t low_duration = seconds_to_us(sink->buffer_low_watermark_seconds);
+        if (low_duration <= 0 || low_duration > s->min_audioq_duration)
+            low_duration = s->min_audioq_duration / 2;
+        s->low_audioq_duration = (low_duration > 0) ? low_duration : 1;
+    } else {
+        s->min_audioq_duration = 0;
+        s->low_audioq_duration = 0;
+    }
+}
+
 static int sink_is_full(struct GrooveSink *sink) {
     struct GrooveSinkPrivate *s = (struct GrooveSinkPrivate *) sink;
+    // push sinks have nothing to fill up
+    if (sink->push)
+        return 0;
+    if (s->min_audioq_duration > 0)
+        return GROOVE_ATOMIC_LOAD(s->audioq_duration) >= s->min_audioq_duration;
     return GROOVE_ATOMIC_LOAD(s->audioq_size) >= s->min_audioq_size;
 }
 
+static bool sink_below_low_watermark(struct GrooveSinkPrivate *s) {
+    if (s->min_audioq_duration > 0)
+        return GROOVE_ATOMIC_LOAD(s->audioq_duration) < s->low_audioq_duration;
+    return GROOVE_ATOMIC_LOAD(s->audioq_size) < s->low_audioq_size;
+}
+
+static int count_decode_sleep(struct GrooveSink *sink) {
+    struct GrooveSinkPrivate *s = (struct GrooveSinkPrivate *) sink;
+    if (sink_is_full(sink))
+        GROOVE_ATOMIC_FETCH_ADD_RELAXED(s->decode_sleep_count, 1);
+    return 0;
+}
+
+// push sinks never fill up, so only the sinks with queues count. if there
+// are none of those, nothing would ever wake the decode thread back up.
 static int every_sink_full(struct GroovePlaylist *playlist) {
-    return every_sink(playlist, sink_is_full, 1);
+    struct GroovePlaylistPrivate *p = (struct GroovePlaylistPrivate *) playlist;
+    if (!p->sink_map)
+        return 1;
+    bool any_queued = false;
+    struct SinkMap *map_item = p->sink_map;
+    while (map_item) {
+        struct SinkStack *stack_item = map_item->stack_head;
+        while (stack_item) {
+            struct GrooveSink *sink = stack_item->sink;
+            if (!sink->push) {
+                if (!sink_is_full(sink))
+                    return 0;
+                any_queued = true;
+            }
+            stack_item = stack_item->next;
+        }
+        map_item = map_item->next;
+    }
+    return any_queued;
 }
 
 static int any_sink_full(struct GroovePlaylist *playlist) {
@@ -616,6 +784,10 @@ static int any_sink_full(struct GroovePlaylist *playlist) {
 
 static int sink_signal_end(struct GrooveSink *sink) {
     struct GrooveSinkPrivate *s = (struct GrooveSinkPrivate *) sink;
+    if (sink->push) {
+        sink->push(sink, NULL);
+        return 0;
+    }
     groove_queue_put(s->audioq, end_of_q_sentinel);
     if (sink->filled) sink->filled(sink);
     return 0;
@@ -640,6 +812,7 @@ static void every_sink_flush(struct GroovePlaylist *playlist) {
 }
 
 static int decode_one_frame(struct GroovePlaylist *playlist, struct GrooveFile *file) {
+    struct GroovePlaylistPrivate *p = (struct GroovePlaylistPrivate *) playlist;
     struct GrooveFilePrivate *f = (struct GrooveFilePrivate *) file;
     AVPacket *pkt = &f->audio_pkt;
 
@@ -665,6 +838,14 @@ static int decode_one_frame(struct GroovePlaylist *playlist, struct GrooveFile *
             }
             avcodec_flush_buffers(f->audio_st->codec);
         }
+        if (f->seek_flush && p->seek_request_time > 0.0) {
+            double latency = groove_os_get_time() - p->seek_request_time;
+            p->stats.seek_count += 1;
+            p->stats.seek_latency_seconds += latency;
+            p->stats.max_seek_latency_seconds = groove_max_double(
+                    p->stats.max_seek_latency_seconds, latency);
+            p->seek_request_time = 0.0;
+        }
         f->ever_seeked = true;
         f->seek_pos = -1;
         f->eof = 0;
@@ -685,7 +866,9 @@ static int decode_one_frame(struct GroovePlaylist *playlist, struct GrooveFile *
         // this file is complete. move on
         return -1;
     }
+    double demux_start = groove_os_get_time();
     int err = av_read_frame(f->ic, pkt);
+    stage_lap(p, &p->stats.demux, &demux_start);
     if (err < 0) {
         // treat all errors as EOF, but log non-EOF errors.
         if (err != AVERROR_EOF) {
@@ -699,6 +882,8 @@ static int decode_one_frame(struct GroovePlaylist *playlist, struct GrooveFile *
         av_packet_unref(pkt);
         return 0;
     }
+    p->stats.demux.bytes += pkt->size;
+    p->stats.demux.count += 1;
     audio_decode_frame(playlist, file);
     av_packet_unref(pkt);
     return 0;
@@ -707,26 +892,38 @@ static int decode_one_frame(struct GroovePlaylist *playlist, struct GrooveFile *
 static void audioq_put(struct GrooveQueue *queue, void *obj) {
     struct GrooveBuffer *buffer = (struct GrooveBuffer *)obj;
     struct GrooveSinkPrivate *s = (struct GrooveSinkPrivate *)queue->context;
+    GROOVE_PROBE3(sink_put, s, buffer ? buffer->item : NULL, buffer ? buffer->size : 0);
     if (buffer == end_of_q_sentinel) {
         GROOVE_ATOMIC_STORE(s->audioq_contains_end, true);
     } else {
         GROOVE_ATOMIC_FETCH_ADD(s->audioq_size, buffer->size);
+        GROOVE_ATOMIC_FETCH_ADD(s->audioq_duration, buffer_duration(buffer));
     }
 }
 
 static void audioq_get(struct GrooveQueue *queue, void *obj) {
     struct GrooveBuffer *buffer = (struct GrooveBuffer *)obj;
     struct GrooveSinkPrivate *s = (struct GrooveSinkPrivate *)queue->context;
+    GROOVE_PROBE3(sink_get, s, buffer ? buffer->item : NULL, buffer ? buffer->size : 0);
     if (buffer == end_of_q_sentinel) {
         GROOVE_ATOMIC_STORE(s->audioq_contains_end, false);
         return;
     }
-    struct GrooveSink *sink = &s->externals;
     GROOVE_ATOMIC_FETCH_ADD(s->audioq_size, -buffer->size);
+    GROOVE_ATOMIC_FETCH_ADD(s->audioq_duration, -buffer_duration(buffer));
+}
+
+static void audioq_drained(struct GrooveQueue *queue) {
+    struct GrooveSinkPrivate *s = (struct GrooveSinkPrivate *)queue->context;
+    struct GrooveSink *sink = &s->externals;
 
+    // between the low and high watermarks the decode thread is left alone
+    // so that it refills the sink in one burst rather than one buffer at a
+    // time.
     struct GroovePlaylist *playlist = sink->playlist;
     struct GroovePlaylistPrivate *p = (struct GroovePlaylistPrivate *) playlist;
-    if (GROOVE_ATOMIC_LOAD(s->audioq_size) < s->min_audioq_size) {
+    if (sink_below_low_watermark(s) && GROOVE_ATOMIC_LOAD(p->decode_waiting))
+    {
         pthread_mutex_lock(&p->drain_cond_mutex);
         pthread_cond_signal(&p->sink_drain_cond);
         pthread_mutex_unlock(&p->drain_cond_mutex);
@@ -742,18 +939,20 @@ static void audioq_cleanup(struct GrooveQueue *queue, void *obj) {
         return;
     }
     GROOVE_ATOMIC_FETCH_ADD(s->audioq_size, -buffer->size);
+    GROOVE_ATOMIC_FETCH_ADD(s->audioq_duration, -buffer_duration(buffer));
     groove_buffer_unref(buffer);
 }
 
-static int audioq_purge(struct GrooveQueue *queue, void *obj) {
+static void *audioq_group(struct GrooveQueue *queue, void *obj) {
     struct GrooveBuffer *buffer = (struct GrooveBuffer *)obj;
     if (buffer == end_of_q_sentinel)
-        return 0;
-    struct GrooveSink *sink = (struct GrooveSink *)queue->context;
-    struct GroovePlaylist *playlist = sink->playlist;
-    struct GroovePlaylistPrivate *p = (struct GroovePlaylistPrivate *) playlist;
-    struct GroovePlaylistItem *item = p->purge_item;
-    return buffer->item == item;
+        return NULL;
+    return buffer->item;
+}
+
+static int audioq_obj_size(struct GrooveQueue *queue, void *obj) {
+    struct GrooveBuffer *buffer = (struct GrooveBuffer *)obj;
+    return (buffer == end_of_q_sentinel) ? 0 : buffer->size;
 }
 
 static void update_playlist_volume(struct GroovePlaylist *playlist) {
@@ -769,6 +968,8 @@ static void *decode_thread(void *arg) {
     struct GroovePlaylistPrivate *p = (struct GroovePlaylistPrivate *)arg;
     struct GroovePlaylist *playlist = &p->externals;
 
+    groove_trace_thread_name("decode");
+
     pthread_mutex_lock(&p->decode_head_mutex);
     while (!p->abort_request) {
         // if we don't have anything to decode, wait until we do
@@ -787,17 +988,44 @@ static void *decode_thread(void *arg) {
         struct GrooveFilePrivate *f = (struct GrooveFilePrivate *) file;
 
         pthread_mutex_lock(&p->drain_cond_mutex);
+        // set this before looking at the sinks so that a consumer which
+        // drains a sink after we look is guaranteed to see it and signal us
+        GROOVE_ATOMIC_STORE(p->decode_waiting, true);
         if (p->detect_full_sinks(playlist) && (f->seek_pos < 0 || !f->seek_flush)) {
             if (!f->paused) {
                 av_read_pause(f->ic);
                 f->paused = 1;
             }
+            every_sink(playlist, count_decode_sleep, 0);
             pthread_mutex_unlock(&p->decode_head_mutex);
+            GROOVE_TRACE_BEGIN("wait for sinks");
+            GROOVE_PROBE1(wait_for_sinks_enter, playlist);
             pthread_cond_wait(&p->sink_drain_cond, &p->drain_cond_mutex);
+            GROOVE_PROBE1(wait_for_sinks_exit, playlist);
+            GROOVE_TRACE_END("wait for sinks");
+            GROOVE_ATOMIC_STORE(p->decode_waiting, false);
             pthread_mutex_unlock(&p->drain_cond_mutex);
+            pthread_mutex_lock(&p->decode_head_mutex);
             continue;
         }
+        GROOVE_ATOMIC_STORE(p->decode_waiting, false);
         pthread_mutex_unlock(&p->drain_cond_mutex);
+
+        // if the process-wide buffer budget is used up, wait for some
+        // decoded audio to be freed. a pending flushing seek goes ahead
+        // since flushing releases buffers.
+        if (groove_budget_exhausted(p->groove) && (f->seek_pos < 0 || !f->seek_flush)) {
+            long wake_count = groove_budget_wake_count(p->groove);
+            pthread_mutex_unlock(&p->decode_head_mutex);
+            GROOVE_TRACE_BEGIN("wait for budget");
+            GROOVE_PROBE1(wait_for_budget_enter, playlist);
+            groove_budget_wait(p->groove, wake_count);
+            GROOVE_PROBE1(wait_for_budget_exit, playlist);
+            GROOVE_TRACE_END("wait for budget");
+            pthread_mutex_lock(&p->decode_head_mutex);
+            continue;
+        }
+
         if (f->paused) {
             av_read_play(f->ic);
             f->paused = 0;
@@ -805,7 +1033,20 @@ static void *decode_thread(void *arg) {
 
         update_playlist_volume(playlist);
 
-        if (decode_one_frame(playlist, file) < 0) {
+        if (p->stats_item != p->decode_head) {
+            p->stats_item = p->decode_head;
+            p->stats.item_audio_seconds = 0.0;
+            p->item_busy_seconds = 0.0;
+        }
+
+        struct GroovePlaylistItem *item = p->decode_head;
+        int64_t bytes_before = p->stats.filter.bytes;
+        GROOVE_TRACE_BEGIN("decode_one_frame");
+        GROOVE_PROBE2(decode_one_frame_enter, playlist, item);
+        int err = decode_one_frame(playlist, file);
+        GROOVE_PROBE3(decode_one_frame_exit, playlist, item, p->stats.filter.bytes - bytes_before);
+        GROOVE_TRACE_END("decode_one_frame");
+        if (err < 0) {
             p->decode_head = p->decode_head->next;
             // seek to beginning of next song
             if (p->decode_head) {
@@ -1058,8 +1299,14 @@ int groove_sink_attach(struct GrooveSink *sink, struct GroovePlaylist *playlist)
     struct GrooveSinkPrivate *s = (struct GrooveSinkPrivate *) sink;
 
     // cache computed audio format stuff
-    s->min_audioq_size = sink->buffer_size_bytes;
-    av_log(NULL, AV_LOG_INFO, "audio queue size: %d\n", s->min_audioq_size);
+    sink_update_watermarks(s);
+    if (s->min_audioq_duration > 0) {
+        av_log(NULL, AV_LOG_INFO, "audio queue duration: %fs, low watermark: %fs\n",
+                s->min_audioq_duration / 1000000.0, s->low_audioq_duration / 1000000.0);
+    } else {
+        av_log(NULL, AV_LOG_INFO, "audio queue size: %d, low watermark: %d\n",
+                s->min_audioq_size, s->low_audioq_size);
+    }
 
     // add the sink to the entry that matches its audio format
     struct GroovePlaylistPrivate *p = (struct GroovePlaylistPrivate *) playlist;
@@ -1087,9 +1334,15 @@ int groove_sink_attach(struct GrooveSink *sink, struct GroovePlaylist *playlist)
 }
 
 int groove_sink_buffer_get(struct GrooveSink *sink, struct GrooveBuffer **buffer, int block) {
+    return groove_sink_buffer_get_timeout(sink, buffer, block ? -1.0 : 0.0);
+}
+
+int groove_sink_buffer_get_timeout(struct GrooveSink *sink, struct GrooveBuffer **buffer,
+        double seconds)
+{
     struct GrooveSinkPrivate *s = (struct GrooveSinkPrivate *) sink;
 
-    if (groove_queue_get(s->audioq, (void**)buffer, block) == 1) {
+    if (groove_queue_get_timeout(s->audioq, (void**)buffer, seconds) == 1) {
         if (*buffer == end_of_q_sentinel) {
             *buffer = NULL;
             return GROOVE_BUFFER_END;
@@ -1102,6 +1355,14 @@ int groove_sink_buffer_get(struct GrooveSink *sink, struct GrooveBuffer **buffer
     }
 }
 
+int groove_sink_buffer_get_many(struct GrooveSink *sink, struct GrooveBuffer **buffers,
+        int max_count, int block)
+{
+    struct GrooveSinkPrivate *s = (struct GrooveSinkPrivate *) sink;
+    int count = groove_queue_get_many(s->audioq, (void**)buffers, max_count, block);
+    return (count < 0) ? 0 : count;
+}
+
 int groove_sink_buffer_peek(struct GrooveSink *sink, int block) {
     struct GrooveSinkPrivate *s = (struct GrooveSinkPrivate *) sink;
     return groove_queue_peek(s->audioq, block);
@@ -1128,6 +1389,12 @@ struct GroovePlaylist * groove_playlist_create(struct Groove *groove) {
 
     p->detect_full_sinks = any_sink_full;
 
+    if (!(p->account = groove_buffer_account_create(groove))) {
+        groove_playlist_destroy(playlist);
+        av_log(NULL, AV_LOG_ERROR, "unable to allocate playlist: out of memory\n");
+        return NULL;
+    }
+
     if (pthread_mutex_init(&p->decode_head_mutex, NULL) != 0) {
         groove_playlist_destroy(playlist);
         av_log(NULL, AV_LOG_ERROR, "unable to allocate decode head mutex\n");
@@ -1235,6 +1502,9 @@ void groove_playlist_destroy(struct GroovePlaylist *playlist) {
         pthread_mutex_unlock(&p->drain_cond_mutex);
     }
 
+    if (p->thread_inited)
+        groove_budget_wake(p->groove);
+
     pthread_join(p->thread_id, NULL);
 
     every_sink(playlist, groove_sink_detach, 0);
@@ -1254,6 +1524,12 @@ void groove_playlist_destroy(struct GroovePlaylist *playlist) {
     if (p->sink_drain_cond_inited)
         pthread_cond_destroy(&p->sink_drain_cond);
 
+    for (int i = 0; i < p->item_chunk_count; i += 1)
+        DEALLOCATE(p->item_chunks[i]);
+    DEALLOCATE(p->item_chunks);
+
+    groove_buffer_account_unref(p->account);
+
     DEALLOCATE(p);
 }
 
@@ -1289,23 +1565,65 @@ void groove_playlist_seek(struct GroovePlaylist *playlist, struct GroovePlaylist
 
     pthread_mutex_unlock(&f->seek_mutex);
 
+    p->seek_request_time = groove_os_get_time();
+
     p->decode_head = item;
     pthread_cond_signal(&p->decode_head_cond);
     pthread_mutex_unlock(&p->decode_head_mutex);
+
+    // the decode thread may be waiting on the buffer budget; it must get a
+    // chance to flush its sinks.
+    groove_budget_wake(p->groove);
+}
+
+// must be called with decode_head_mutex held
+static struct GroovePlaylistItemPrivate *item_alloc(struct GroovePlaylistPrivate *p) {
+    if (!p->item_free_list) {
+        struct GroovePlaylistItemPrivate **new_chunks = REALLOCATE_NONZERO(
+                struct GroovePlaylistItemPrivate *, p->item_chunks, p->item_chunk_count + 1);
+        if (!new_chunks)
+            return NULL;
+        p->item_chunks = new_chunks;
+
+        struct GroovePlaylistItemPrivate *chunk = ALLOCATE(struct GroovePlaylistItemPrivate, ITEM_CHUNK_SIZE);
+        if (!chunk)
+            return NULL;
+        p->item_chunks[p->item_chunk_count] = chunk;
+
+        // push in reverse so that the lowest slot is handed out first
+        uint32_t base_slot = p->item_chunk_count * ITEM_CHUNK_SIZE;
+        for (int i = ITEM_CHUNK_SIZE - 1; i >= 0; i -= 1) {
+            struct GroovePlaylistItemPrivate *it = &chunk[i];
+            it->slot = base_slot + i;
+            it->generation = 1;
+            it->next_free = p->item_free_list;
+            p->item_free_list = it;
+        }
+        p->item_chunk_count += 1;
+    }
+
+    struct GroovePlaylistItemPrivate *it = p->item_free_list;
+    p->item_free_list = it->next_free;
+    it->next_free = NULL;
+    it->in_use = true;
+    memset(&it->externals, 0, sizeof(struct GroovePlaylistItem));
+    return it;
+}
+
+// must be called with decode_head_mutex held
+static void item_free(struct GroovePlaylistPrivate *p, struct GroovePlaylistItemPrivate *it) {
+    it->in_use = false;
+    // generation 0 is never handed out so that a handle of 0 is never valid
+    it->generation += 1;
+    if (it->generation == 0)
+        it->generation = 1;
+    it->next_free = p->item_free_list;
+    p->item_free_list = it;
 }
 
 struct GroovePlaylistItem *groove_playlist_insert(struct GroovePlaylist *playlist,
         struct GrooveFile *file, double gain, double peak, struct GroovePlaylistItem *next)
 {
-    struct GroovePlaylistItem * item = ALLOCATE(struct GroovePlaylistItem, 1);
-    if (!item)
-        return NULL;
-
-    item->file = file;
-    item->next = next;
-    item->gain = gain;
-    item->peak = peak;
-
     struct GroovePlaylistPrivate *p = (struct GroovePlaylistPrivate *) playlist;
     struct GrooveFilePrivate *f = (struct GrooveFilePrivate *) file;
 
@@ -1313,6 +1631,18 @@ struct GroovePlaylistItem *groove_playlist_insert(struct GroovePlaylist *playlis
     // while we're screwing around with the queue
     pthread_mutex_lock(&p->decode_head_mutex);
 
+    struct GroovePlaylistItemPrivate *it = item_alloc(p);
+    if (!it) {
+        pthread_mutex_unlock(&p->decode_head_mutex);
+        return NULL;
+    }
+    struct GroovePlaylistItem *item = &it->externals;
+
+    item->file = file;
+    item->next = next;
+    item->gain = gain;
+    item->peak = peak;
+
     if (next) {
         if (next->prev) {
             item->prev = next->prev;
@@ -1345,12 +1675,12 @@ struct GroovePlaylistItem *groove_playlist_insert(struct GroovePlaylist *playlis
 static int purge_sink(struct GrooveSink *sink) {
     struct GrooveSinkPrivate *s = (struct GrooveSinkPrivate *) sink;
 
-    groove_queue_purge(s->audioq);
-
     struct GroovePlaylist *playlist = sink->playlist;
     struct GroovePlaylistPrivate *p = (struct GroovePlaylistPrivate *) playlist;
     struct GroovePlaylistItem *item = p->purge_item;
 
+    groove_queue_purge(s->audioq, item);
+
     if (sink->purge)
         sink->purge(sink, item);
 
@@ -1380,17 +1710,17 @@ void groove_playlist_remove(struct GroovePlaylist *playlist, struct GroovePlayli
 
     // in each sink,
     // we must be absolutely sure to purge the audio buffer queue
-    // of references to item before freeing it at the bottom of this method
+    // of references to item before its slot is recycled below
     p->purge_item = item;
     every_sink(playlist, purge_sink, 0);
     p->purge_item = NULL;
 
+    item_free(p, (struct GroovePlaylistItemPrivate *) item);
+
     pthread_mutex_lock(&p->drain_cond_mutex);
     pthread_cond_signal(&p->sink_drain_cond);
     pthread_mutex_unlock(&p->drain_cond_mutex);
     pthread_mutex_unlock(&p->decode_head_mutex);
-
-    DEALLOCATE(item);
 }
 
 void groove_playlist_clear(struct GroovePlaylist *playlist) {
@@ -1413,6 +1743,31 @@ int groove_playlist_count(struct GroovePlaylist *playlist) {
     return count;
 }
 
+uint64_t groove_playlist_item_handle(struct GroovePlaylistItem *item) {
+    struct GroovePlaylistItemPrivate *it = (struct GroovePlaylistItemPrivate *) item;
+    return (((uint64_t)it->generation) << 32) | it->slot;
+}
+
+struct GroovePlaylistItem *groove_playlist_item_from_handle(struct GroovePlaylist *playlist,
+        uint64_t handle)
+{
+    struct GroovePlaylistPrivate *p = (struct GroovePlaylistPrivate *) playlist;
+    uint32_t slot = (uint32_t)(handle & 0xffffffff);
+    uint32_t generation = (uint32_t)(handle >> 32);
+    struct GroovePlaylistItem *item = NULL;
+
+    pthread_mutex_lock(&p->decode_head_mutex);
+    uint32_t chunk_index = slot / ITEM_CHUNK_SIZE;
+    if (chunk_index < (uint32_t)p->item_chunk_count) {
+        struct GroovePlaylistItemPrivate *it = &p->item_chunks[chunk_index][slot % ITEM_CHUNK_SIZE];
+        if (it->in_use && it->generation == generation)
+            item = &it->externals;
+    }
+    pthread_mutex_unlock(&p->decode_head_mutex);
+
+    return item;
+}
+
 void groove_playlist_set_item_gain_peak(struct GroovePlaylist *playlist, struct GroovePlaylistItem *item,
         double gain, double peak)
 {
@@ -1458,6 +1813,27 @@ void groove_playlist_set_gain(struct GroovePlaylist *playlist, double gain) {
     pthread_mutex_unlock(&p->decode_head_mutex);
 }
 
+int64_t groove_playlist_get_buffer_usage(struct GroovePlaylist *playlist) {
+    struct GroovePlaylistPrivate *p = (struct GroovePlaylistPrivate *) playlist;
+    return GROOVE_ATOMIC_LOAD(p->account->used);
+}
+
+void groove_playlist_get_stats(struct GroovePlaylist *playlist, struct GroovePlaylistStats *stats) {
+    struct GroovePlaylistPrivate *p = (struct GroovePlaylistPrivate *) playlist;
+
+    pthread_mutex_lock(&p->decode_head_mutex);
+    *stats = p->stats;
+    double item_busy_seconds = p->item_busy_seconds;
+    pthread_mutex_unlock(&p->decode_head_mutex);
+
+    double busy_seconds = stats->demux.seconds + stats->decode.seconds +
+        stats->filter.seconds + stats->queue.seconds;
+    stats->realtime_factor = (busy_seconds > 0.0) ?
+        stats->audio_seconds / busy_seconds : 0.0;
+    stats->item_realtime_factor = (item_busy_seconds > 0.0) ?
+        stats->item_audio_seconds / item_busy_seconds : 0.0;
+}
+
 int groove_playlist_playing(struct GroovePlaylist *playlist) {
     struct GroovePlaylistPrivate *p = (struct GroovePlaylistPrivate *) playlist;
     return !GROOVE_ATOMIC_LOAD(p->paused);
@@ -1474,6 +1850,7 @@ struct GrooveSink * groove_sink_create(struct Groove *groove) {
     s->groove = groove;
 
     GROOVE_ATOMIC_STORE(s->audioq_size, 0);
+    GROOVE_ATOMIC_STORE(s->audioq_duration, 0);
     GROOVE_ATOMIC_STORE(s->audioq_contains_end, false);
 
     struct GrooveSink *sink = &s->externals;
@@ -1493,7 +1870,9 @@ struct GrooveSink * groove_sink_create(struct Groove *groove) {
     s->audioq->cleanup = audioq_cleanup;
     s->audioq->put = audioq_put;
     s->audioq->get = audioq_get;
-    s->audioq->purge = audioq_purge;
+    s->audioq->drained = audioq_drained;
+    s->audioq->group = audioq_group;
+    s->audioq->size = audioq_obj_size;
 
     return sink;
 }
@@ -1547,8 +1926,24 @@ void groove_sink_set_buffer_size_bytes(struct GrooveSink *sink, int buffer_size_
 
     pthread_mutex_lock(&p->decode_head_mutex);
     sink->buffer_size_bytes = buffer_size_bytes;
-    s->min_audioq_size = sink->buffer_size_bytes;
-    if (GROOVE_ATOMIC_LOAD(s->audioq_size) < s->min_audioq_size) {
+    sink_update_watermarks(s);
+    if (!sink_is_full(sink)) {
+        pthread_mutex_lock(&p->drain_cond_mutex);
+        pthread_cond_signal(&p->sink_drain_cond);
+        pthread_mutex_unlock(&p->drain_cond_mutex);
+    }
+    pthread_mutex_unlock(&p->decode_head_mutex);
+}
+
+void groove_sink_set_buffer_size_seconds(struct GrooveSink *sink, double buffer_size_seconds) {
+    struct GroovePlaylist *playlist = (struct GroovePlaylist *) sink->playlist;
+    struct GrooveSinkPrivate *s = (struct GrooveSinkPrivate *) sink;
+    struct GroovePlaylistPrivate *p = (struct GroovePlaylistPrivate *) playlist;
+
+    pthread_mutex_lock(&p->decode_head_mutex);
+    sink->buffer_size_seconds = buffer_size_seconds;
+    sink_update_watermarks(s);
+    if (!sink_is_full(sink)) {
         pthread_mutex_lock(&p->drain_cond_mutex);
         pthread_cond_signal(&p->sink_drain_cond);
         pthread_mutex_unlock(&p->drain_cond_mutex);
@@ -1556,11 +1951,31 @@ void groove_sink_set_buffer_size_bytes(struct GrooveSink *sink, int buffer_size_
     pthread_mutex_unlock(&p->decode_head_mutex);
 }
 
+double groove_sink_get_fill_duration(struct GrooveSink *sink) {
+    struct GrooveSinkPrivate *s = (struct GrooveSinkPrivate *) sink;
+    return GROOVE_ATOMIC_LOAD(s->audioq_duration) / 1000000.0;
+}
+
+int groove_sink_get_fd(struct GrooveSink *sink) {
+    struct GrooveSinkPrivate *s = (struct GrooveSinkPrivate *) sink;
+    return groove_queue_get_fd(s->audioq);
+}
+
+int groove_sink_is_full(struct GrooveSink *sink) {
+    return sink_is_full(sink);
+}
+
 int groove_sink_contains_end_of_playlist(struct GrooveSink *sink) {
     struct GrooveSinkPrivate *s = (struct GrooveSinkPrivate *) sink;
     return GROOVE_ATOMIC_LOAD(s->audioq_contains_end);
 }
 
+void groove_sink_get_stats(struct GrooveSink *sink, struct GrooveSinkStats *stats) {
+    struct GrooveSinkPrivate *s = (struct GrooveSinkPrivate *) sink;
+    groove_queue_get_stats(s->audioq, &stats->queue);
+    stats->decode_sleep_count = GROOVE_ATOMIC_LOAD_RELAXED(s->decode_sleep_count);
+}
+
 void groove_sink_set_only_format(struct GrooveSink *sink,
         const struct GrooveAudioFormat *audio_format)
 {
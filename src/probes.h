@@ -0,0 +1,38 @@
+/*
+ * Copyright (c) 2015 Andrew Kelley
+ *
+ * This file is part of libgroove, which is MIT licensed.
+ * See http://opensource.org/licenses/MIT
+ */
+
+#ifndef GROOVE_PROBES_H
+#define GROOVE_PROBES_H
+
+#include "config.h"
+
+// USDT probes which perf or bpftrace can attach to in a running process,
+// for example:
+//   bpftrace -e 'usdt:/usr/lib/libgroove.so:libgroove:audio_underflow { @[pid] = count(); }'
+// each probe is a single nop until something attaches to it. they compile
+// to nothing unless libgroove is configured with ENABLE_USDT.
+#ifdef GROOVE_HAVE_USDT
+
+#include <sys/sdt.h>
+
+#define GROOVE_PROBE1(name, a) DTRACE_PROBE1(libgroove, name, a)
+#define GROOVE_PROBE2(name, a, b) DTRACE_PROBE2(libgroove, name, a, b)
+#define GROOVE_PROBE3(name, a, b, c) DTRACE_PROBE3(libgroove, name, a, b, c)
+
+#else
+
+// the arguments are mentioned but never evaluated, so that locals which
+// only exist to be passed to a probe do not cause unused variable warnings
+#define GROOVE_PROBE1(name, a) do { (void)sizeof(a); } while (0)
+#define GROOVE_PROBE2(name, a, b) do { (void)sizeof(a); (void)sizeof(b); } while (0)
+#define GROOVE_PROBE3(name, a, b, c) do { \
+    (void)sizeof(a); (void)sizeof(b); (void)sizeof(c); \
+} while (0)
+
+#endif
+
+#endif
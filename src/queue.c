@@ -7,23 +7,191 @@
 
 #include "queue.h"
 #include "util.h"
+#include "atomics.h"
+#include "trace.h"
 
 #include <pthread.h>
+#include <errno.h>
+#include <time.h>
+#include <math.h>
+#include <stdint.h>
+
+// timed gets measure against the monotonic clock where the condition
+// variable can be told to use it
+#if defined(__MACH__)
+#define GROOVE_QUEUE_CLOCK CLOCK_REALTIME
+#else
+#define GROOVE_QUEUE_CLOCK CLOCK_MONOTONIC
+#endif
+
+// timeouts longer than this wait forever, which also keeps the conversion
+// to time_t defined
+#define MAX_TIMEOUT_SECONDS 1e9
+
+#if defined(__linux__)
+#define GROOVE_HAVE_EVENTFD
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
 
 struct ItemList {
     void *obj;
     struct ItemList *next;
 };
 
+// a run of consecutive items which all belong to the same group. the
+// segments partition the item list in order, and neighboring segments never
+// share a group, so purging a group only visits the items in it.
+struct Segment {
+    void *group;
+    struct ItemList *first;
+    struct ItemList *last;
+    struct Segment *prev;
+    struct Segment *next;
+};
+
 struct GrooveQueuePrivate {
     struct GrooveQueue externals;
     struct ItemList *first;
     struct ItemList *last;
+    struct Segment *first_segment;
+    struct Segment *last_segment;
     pthread_mutex_t mutex;
     pthread_cond_t cond;
     int abort_request;
+    // readable while the queue has items or is aborted. -1 until
+    // groove_queue_get_fd is called.
+    int event_fd;
+    // whether we have written to event_fd since we last drained it
+    bool event_fd_signaled;
+
+    // protected by mutex
+    long item_count;
+    long byte_count;
+
+    // statistics. only written with the mutex held, but read without it.
+    struct GrooveAtomicLong put_count;
+    struct GrooveAtomicLong get_count;
+    struct GrooveAtomicLong wait_count;
+    struct GrooveAtomicLongLong wait_ns;
+    struct GrooveAtomicLong max_items;
+    struct GrooveAtomicLong max_bytes;
+    struct GrooveAtomicLong purge_count;
+    struct GrooveAtomicLong flush_count;
 };
 
+static long obj_size(struct GrooveQueue *queue, void *obj) {
+    return queue->size ? queue->size(queue, obj) : 0;
+}
+
+// must be called with the mutex held after anything which might change
+// whether a get would return immediately
+static void update_event_fd(struct GrooveQueuePrivate *q) {
+#ifdef GROOVE_HAVE_EVENTFD
+    if (q->event_fd < 0)
+        return;
+    bool ready = q->first || q->abort_request;
+    if (ready && !q->event_fd_signaled) {
+        uint64_t one = 1;
+        if (write(q->event_fd, &one, sizeof(one)) == sizeof(one))
+            q->event_fd_signaled = true;
+    } else if (!ready && q->event_fd_signaled) {
+        uint64_t count;
+        if (read(q->event_fd, &count, sizeof(count)) == sizeof(count))
+            q->event_fd_signaled = false;
+    }
+#endif
+}
+
+static bool timed_wait_until_ready(struct GrooveQueuePrivate *q, const struct timespec *start,
+        double seconds)
+{
+    // seconds is finite and at most MAX_TIMEOUT_SECONDS, but the clock may
+    // already be close to the end of a 32-bit time_t
+    static const time_t max_sec = (sizeof(time_t) >= 8) ? (time_t)INT64_MAX : (time_t)INT32_MAX;
+    struct timespec deadline = *start;
+    time_t whole_seconds = (time_t)seconds;
+    deadline.tv_nsec += (long)((seconds - (double)whole_seconds) * 1000000000.0);
+    if (deadline.tv_nsec >= 1000000000L) {
+        whole_seconds += 1;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    if (deadline.tv_sec > max_sec - whole_seconds)
+        deadline.tv_sec = max_sec;
+    else
+        deadline.tv_sec += whole_seconds;
+
+    while (!q->first && !q->abort_request) {
+        if (pthread_cond_timedwait(&q->cond, &q->mutex, &deadline) == ETIMEDOUT)
+            return q->first || q->abort_request;
+    }
+    return true;
+}
+
+// must be called with the mutex held. waits until the queue has an item or
+// is aborted. seconds < 0, NaN, infinity and anything over
+// MAX_TIMEOUT_SECONDS wait forever, and 0 does not wait at all. returns false
+// if the timeout expired first.
+static bool wait_until_ready(struct GrooveQueuePrivate *q, double seconds) {
+    if (q->first || q->abort_request)
+        return true;
+    if (seconds == 0.0)
+        return false;
+
+    GROOVE_TRACE_BEGIN("queue wait");
+    struct timespec start;
+    clock_gettime(GROOVE_QUEUE_CLOCK, &start);
+    GROOVE_ATOMIC_FETCH_ADD_RELAXED(q->wait_count, 1);
+
+    bool ready = true;
+    if (seconds < 0.0 || !isfinite(seconds) || seconds > MAX_TIMEOUT_SECONDS) {
+        while (!q->first && !q->abort_request)
+            pthread_cond_wait(&q->cond, &q->mutex);
+    } else {
+        ready = timed_wait_until_ready(q, &start, seconds);
+    }
+
+    struct timespec end;
+    clock_gettime(GROOVE_QUEUE_CLOCK, &end);
+    long long waited = (end.tv_sec - start.tv_sec) * 1000000000LL + (end.tv_nsec - start.tv_nsec);
+    GROOVE_ATOMIC_FETCH_ADD_RELAXED(q->wait_ns, waited);
+    GROOVE_TRACE_END("queue wait");
+
+    return ready;
+}
+
+static void remove_segment(struct GrooveQueuePrivate *q, struct Segment *seg) {
+    if (seg->prev)
+        seg->prev->next = seg->next;
+    else
+        q->first_segment = seg->next;
+    if (seg->next)
+        seg->next->prev = seg->prev;
+    else
+        q->last_segment = seg->prev;
+    DEALLOCATE(seg);
+}
+
+// must be called with the mutex held and the queue not empty
+static struct ItemList *pop_first(struct GrooveQueuePrivate *q) {
+    struct ItemList *el = q->first;
+    q->first = el->next;
+    if (!q->first)
+        q->last = NULL;
+
+    q->item_count -= 1;
+    q->byte_count -= obj_size(&q->externals, el->obj);
+    GROOVE_ATOMIC_FETCH_ADD_RELAXED(q->get_count, 1);
+
+    struct Segment *seg = q->first_segment;
+    if (seg->last == el)
+        remove_segment(q, seg);
+    else
+        seg->first = el->next;
+
+    return el;
+}
+
 struct GrooveQueue *groove_queue_create(void) {
     struct GrooveQueuePrivate *q = ALLOCATE(struct GrooveQueuePrivate, 1);
     if (!q)
@@ -33,11 +201,23 @@ struct GrooveQueue *groove_queue_create(void) {
         DEALLOCATE(q);
         return NULL;
     }
-    if (pthread_cond_init(&q->cond, NULL) != 0) {
+    pthread_condattr_t cond_attr;
+    if (pthread_condattr_init(&cond_attr) != 0) {
+        pthread_mutex_destroy(&q->mutex);
         DEALLOCATE(q);
+        return NULL;
+    }
+#if !defined(__MACH__)
+    pthread_condattr_setclock(&cond_attr, GROOVE_QUEUE_CLOCK);
+#endif
+    int err = pthread_cond_init(&q->cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+    if (err != 0) {
         pthread_mutex_destroy(&q->mutex);
+        DEALLOCATE(q);
         return NULL;
     }
+    q->event_fd = -1;
     struct GrooveQueue *queue = &q->externals;
     queue->cleanup = groove_queue_cleanup_default;
     return queue;
@@ -59,6 +239,21 @@ void groove_queue_flush(struct GrooveQueue *queue) {
     q->first = NULL;
     q->last = NULL;
 
+    struct Segment *seg = q->first_segment;
+    while (seg) {
+        struct Segment *next = seg->next;
+        DEALLOCATE(seg);
+        seg = next;
+    }
+    q->first_segment = NULL;
+    q->last_segment = NULL;
+
+    q->item_count = 0;
+    q->byte_count = 0;
+    GROOVE_ATOMIC_FETCH_ADD_RELAXED(q->flush_count, 1);
+
+    update_event_fd(q);
+
     pthread_mutex_unlock(&q->mutex);
 }
 
@@ -67,6 +262,10 @@ void groove_queue_destroy(struct GrooveQueue *queue) {
     struct GrooveQueuePrivate *q = (struct GrooveQueuePrivate *) queue;
     pthread_mutex_destroy(&q->mutex);
     pthread_cond_destroy(&q->cond);
+#ifdef GROOVE_HAVE_EVENTFD
+    if (q->event_fd >= 0)
+        close(q->event_fd);
+#endif
     DEALLOCATE(q);
 }
 
@@ -76,6 +275,7 @@ void groove_queue_abort(struct GrooveQueue *queue) {
     pthread_mutex_lock(&q->mutex);
 
     q->abort_request = 1;
+    update_event_fd(q);
 
     pthread_cond_signal(&q->cond);
     pthread_mutex_unlock(&q->mutex);
@@ -87,6 +287,7 @@ void groove_queue_reset(struct GrooveQueue *queue) {
     pthread_mutex_lock(&q->mutex);
 
     q->abort_request = 0;
+    update_event_fd(q);
 
     pthread_mutex_unlock(&q->mutex);
 }
@@ -99,18 +300,50 @@ int groove_queue_put(struct GrooveQueue *queue, void *obj) {
 
     el1->obj = obj;
 
+    void *group = queue->group ? queue->group(queue, obj) : NULL;
+
     struct GrooveQueuePrivate *q = (struct GrooveQueuePrivate *) queue;
     pthread_mutex_lock(&q->mutex);
 
+    struct Segment *seg = q->last_segment;
+    if (seg && seg->group == group) {
+        seg->last = el1;
+    } else {
+        seg = ALLOCATE(struct Segment, 1);
+        if (!seg) {
+            pthread_mutex_unlock(&q->mutex);
+            DEALLOCATE(el1);
+            return GrooveErrorNoMem;
+        }
+        seg->group = group;
+        seg->first = el1;
+        seg->last = el1;
+        seg->prev = q->last_segment;
+        if (q->last_segment)
+            q->last_segment->next = seg;
+        else
+            q->first_segment = seg;
+        q->last_segment = seg;
+    }
+
     if (!q->last)
         q->first = el1;
     else
         q->last->next = el1;
     q->last = el1;
 
+    q->item_count += 1;
+    q->byte_count += obj_size(queue, obj);
+    GROOVE_ATOMIC_FETCH_ADD_RELAXED(q->put_count, 1);
+    if (q->item_count > GROOVE_ATOMIC_LOAD_RELAXED(q->max_items))
+        GROOVE_ATOMIC_STORE_RELAXED(q->max_items, q->item_count);
+    if (q->byte_count > GROOVE_ATOMIC_LOAD_RELAXED(q->max_bytes))
+        GROOVE_ATOMIC_STORE_RELAXED(q->max_bytes, q->byte_count);
+
     if (queue->put)
         queue->put(queue, obj);
 
+    update_event_fd(q);
     pthread_cond_signal(&q->cond);
     pthread_mutex_unlock(&q->mutex);
 
@@ -123,58 +356,78 @@ int groove_queue_peek(struct GrooveQueue *queue, int block) {
     struct GrooveQueuePrivate *q = (struct GrooveQueuePrivate *) queue;
     pthread_mutex_lock(&q->mutex);
 
-    for (;;) {
-        if (q->abort_request) {
-            ret = -1;
-            break;
-        }
-
-        if (q->first) {
-            ret = 1;
-            break;
-        } else if (!block) {
-            ret = 0;
-            break;
-        } else {
-            pthread_cond_wait(&q->cond, &q->mutex);
-        }
-    }
+    if (!wait_until_ready(q, block ? -1.0 : 0.0))
+        ret = 0;
+    else if (q->abort_request)
+        ret = -1;
+    else
+        ret = 1;
 
     pthread_mutex_unlock(&q->mutex);
     return ret;
 }
 
 int groove_queue_get(struct GrooveQueue *queue, void **obj_ptr, int block) {
-    struct ItemList *ev1;
+    return groove_queue_get_timeout(queue, obj_ptr, block ? -1.0 : 0.0);
+}
+
+int groove_queue_get_timeout(struct GrooveQueue *queue, void **obj_ptr, double seconds) {
     int ret;
 
     struct GrooveQueuePrivate *q = (struct GrooveQueuePrivate *) queue;
     pthread_mutex_lock(&q->mutex);
 
-    for (;;) {
-        if (q->abort_request) {
-            ret = -1;
-            break;
-        }
+    if (!wait_until_ready(q, seconds)) {
+        ret = 0;
+    } else if (q->abort_request) {
+        ret = -1;
+    } else {
+        struct ItemList *ev1 = pop_first(q);
+
+        if (queue->get)
+            queue->get(queue, ev1->obj);
+
+        *obj_ptr = ev1->obj;
+        DEALLOCATE(ev1);
+        update_event_fd(q);
+        if (queue->drained)
+            queue->drained(queue);
+        ret = 1;
+    }
+
+    pthread_mutex_unlock(&q->mutex);
+    return ret;
+}
+
+int groove_queue_get_many(struct GrooveQueue *queue, void **objs, int max_count, int block) {
+    int ret;
+
+    struct GrooveQueuePrivate *q = (struct GrooveQueuePrivate *) queue;
+    pthread_mutex_lock(&q->mutex);
 
-        ev1 = q->first;
-        if (ev1) {
-            q->first = ev1->next;
-            if (!q->first)
-                q->last = NULL;
+    if (!wait_until_ready(q, (block && max_count > 0) ? -1.0 : 0.0)) {
+        ret = 0;
+    } else if (q->abort_request) {
+        ret = -1;
+    } else {
+        ret = 0;
+        while (q->first && ret < max_count) {
+            struct ItemList *ev1 = pop_first(q);
 
             if (queue->get)
                 queue->get(queue, ev1->obj);
 
-            *obj_ptr = ev1->obj;
+            void *obj = ev1->obj;
+            objs[ret] = obj;
+            ret += 1;
             DEALLOCATE(ev1);
-            ret = 1;
-            break;
-        } else if(!block) {
-            ret = 0;
-            break;
-        } else {
-            pthread_cond_wait(&q->cond, &q->mutex);
+            if (!obj)
+                break;
+        }
+        if (ret > 0) {
+            update_event_fd(q);
+            if (queue->drained)
+                queue->drained(queue);
         }
     }
 
@@ -182,41 +435,94 @@ int groove_queue_get(struct GrooveQueue *queue, void **obj_ptr, int block) {
     return ret;
 }
 
-void groove_queue_purge(struct GrooveQueue *queue) {
+void groove_queue_purge(struct GrooveQueue *queue, void *group) {
+    if (!group)
+        return;
+
     struct GrooveQueuePrivate *q = (struct GrooveQueuePrivate *) queue;
 
     pthread_mutex_lock(&q->mutex);
-    struct ItemList *node = q->first;
-    struct ItemList *prev = NULL;
-    while (node) {
-        if (queue->purge(queue, node->obj)) {
-            if (prev) {
-                prev->next = node->next;
-                if (queue->cleanup)
-                    queue->cleanup(queue, node->obj);
-                DEALLOCATE(node);
-                node = prev->next;
-                if (!node)
-                    q->last = prev;
-            } else {
-                struct ItemList *next = node->next;
-                if (queue->cleanup)
-                    queue->cleanup(queue, node->obj);
-                DEALLOCATE(node);
-                q->first = next;
-                node = next;
-                if (!node)
-                    q->last = NULL;
-            }
-        } else {
-            prev = node;
-            node = node->next;
+    long prev_item_count = q->item_count;
+    struct Segment *seg = q->first_segment;
+    while (seg) {
+        if (seg->group != group) {
+            seg = seg->next;
+            continue;
         }
+
+        // unlink the whole run of items at once
+        struct ItemList *before = seg->prev ? seg->prev->last : NULL;
+        struct ItemList *after = seg->last->next;
+        if (before)
+            before->next = after;
+        else
+            q->first = after;
+        if (!after)
+            q->last = before;
+
+        struct ItemList *node = seg->first;
+        while (node != after) {
+            struct ItemList *next = node->next;
+            q->item_count -= 1;
+            q->byte_count -= obj_size(queue, node->obj);
+            if (queue->cleanup)
+                queue->cleanup(queue, node->obj);
+            DEALLOCATE(node);
+            node = next;
+        }
+
+        // the neighbors may now belong to the same group; merge them
+        struct Segment *prev = seg->prev;
+        struct Segment *next = seg->next;
+        remove_segment(q, seg);
+        if (prev && next && prev->group == next->group) {
+            prev->last = next->last;
+            remove_segment(q, next);
+            next = prev->next;
+        }
+        seg = next;
     }
+    if (q->item_count != prev_item_count)
+        GROOVE_ATOMIC_FETCH_ADD_RELAXED(q->purge_count, 1);
+    update_event_fd(q);
     pthread_mutex_unlock(&q->mutex);
 }
 
+int groove_queue_get_fd(struct GrooveQueue *queue) {
+#ifdef GROOVE_HAVE_EVENTFD
+    struct GrooveQueuePrivate *q = (struct GrooveQueuePrivate *) queue;
+    int ret;
+
+    pthread_mutex_lock(&q->mutex);
+    if (q->event_fd < 0) {
+        q->event_fd = eventfd(0, EFD_NONBLOCK|EFD_CLOEXEC);
+        if (q->event_fd >= 0) {
+            q->event_fd_signaled = false;
+            update_event_fd(q);
+        }
+    }
+    ret = (q->event_fd >= 0) ? q->event_fd : GrooveErrorSystemResources;
+    pthread_mutex_unlock(&q->mutex);
+
+    return ret;
+#else
+    return GrooveErrorUnsupported;
+#endif
+}
+
 void groove_queue_cleanup_default(struct GrooveQueue *queue, void *obj) {
     DEALLOCATE(obj);
 }
 
+
+void groove_queue_get_stats(struct GrooveQueue *queue, struct GrooveQueueStats *stats) {
+    struct GrooveQueuePrivate *q = (struct GrooveQueuePrivate *) queue;
+    stats->put_count = GROOVE_ATOMIC_LOAD_RELAXED(q->put_count);
+    stats->get_count = GROOVE_ATOMIC_LOAD_RELAXED(q->get_count);
+    stats->wait_count = GROOVE_ATOMIC_LOAD_RELAXED(q->wait_count);
+    stats->wait_seconds = GROOVE_ATOMIC_LOAD_RELAXED(q->wait_ns) / 1000000000.0;
+    stats->max_items = GROOVE_ATOMIC_LOAD_RELAXED(q->max_items);
+    stats->max_bytes = GROOVE_ATOMIC_LOAD_RELAXED(q->max_bytes);
+    stats->purge_count = GROOVE_ATOMIC_LOAD_RELAXED(q->purge_count);
+    stats->flush_count = GROOVE_ATOMIC_LOAD_RELAXED(q->flush_count);
+}
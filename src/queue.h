@@ -8,13 +8,23 @@
 #ifndef GROOVE_QUEUE_H
 #define GROOVE_QUEUE_H
 
+struct GrooveQueueStats;
+
 struct GrooveQueue {
     void *context;
     // defaults to groove_queue_cleanup_default
     void (*cleanup)(struct GrooveQueue*, void *obj);
     void (*put)(struct GrooveQueue*, void *obj);
     void (*get)(struct GrooveQueue*, void *obj);
-    int (*purge)(struct GrooveQueue*, void *obj);
+    // called once after a get or get_many has removed at least one object
+    void (*drained)(struct GrooveQueue*);
+    // returns the group an object belongs to, such as its playlist item, so
+    // that groove_queue_purge can drop a group without scanning the queue.
+    // NULL means the object belongs to no group.
+    void *(*group)(struct GrooveQueue*, void *obj);
+    // optional. returns the size in bytes of an object, for the high-water
+    // mark reported by groove_queue_get_stats
+    int (*size)(struct GrooveQueue*, void *obj);
 };
 
 struct GrooveQueue *groove_queue_create(void);
@@ -31,10 +41,28 @@ int groove_queue_put(struct GrooveQueue *queue, void *obj);
 // returns -1 if aborted, 1 if got event, 0 if no event ready
 int groove_queue_get(struct GrooveQueue *queue, void **obj_ptr, int block);
 
+// like groove_queue_get but gives up after waiting the given number of
+// seconds. seconds < 0, NaN and infinity wait forever. returns 0 on timeout.
+int groove_queue_get_timeout(struct GrooveQueue *queue, void **obj_ptr, double seconds);
+
+// takes up to max_count objects with a single lock acquisition. stops early
+// after taking a NULL object, which queues use as an end sentinel.
+// returns -1 if aborted, otherwise the number of objects taken, which is
+// only 0 if block is 0 and the queue is empty.
+int groove_queue_get_many(struct GrooveQueue *queue, void **objs, int max_count, int block);
+
 int groove_queue_peek(struct GrooveQueue *queue, int block);
 
-void groove_queue_purge(struct GrooveQueue *queue);
+// removes and cleans up every object in the given group
+void groove_queue_purge(struct GrooveQueue *queue, void *group);
+
+// returns an eventfd which is readable while a get would not block, creating
+// it on first use. the queue owns the file descriptor. returns < 0 on error.
+int groove_queue_get_fd(struct GrooveQueue *queue);
 
 void groove_queue_cleanup_default(struct GrooveQueue *queue, void *obj);
 
+// may be called from any thread without blocking the queue
+void groove_queue_get_stats(struct GrooveQueue *queue, struct GrooveQueueStats *stats);
+
 #endif
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2015 Andrew Kelley
+ *
+ * This file is part of libgroove, which is MIT licensed.
+ * See http://opensource.org/licenses/MIT
+ */
+
+#include "ring.h"
+#include "atomics.h"
+#include "util.h"
+
+struct GrooveRing {
+    // total number of objects ever pushed. only the producer writes it.
+    struct GrooveAtomicLong head;
+    // total number of objects ever popped. only the consumer writes it.
+    struct GrooveAtomicLong tail;
+    int capacity;
+    void **objs;
+};
+
+struct GrooveRing *groove_ring_create(int capacity) {
+    struct GrooveRing *ring = ALLOCATE(struct GrooveRing, 1);
+    if (!ring)
+        return NULL;
+    ring->objs = ALLOCATE(void *, capacity);
+    if (!ring->objs) {
+        groove_ring_destroy(ring);
+        return NULL;
+    }
+    ring->capacity = capacity;
+    return ring;
+}
+
+void groove_ring_destroy(struct GrooveRing *ring) {
+    if (!ring)
+        return;
+    DEALLOCATE(ring->objs);
+    DEALLOCATE(ring);
+}
+
+bool groove_ring_push(struct GrooveRing *ring, void *obj) {
+    long head = GROOVE_ATOMIC_LOAD_RELAXED(ring->head);
+    if (head - GROOVE_ATOMIC_LOAD(ring->tail) >= ring->capacity)
+        return false;
+    ring->objs[head % ring->capacity] = obj;
+    // publishes the slot to the consumer
+    GROOVE_ATOMIC_STORE(ring->head, head + 1);
+    return true;
+}
+
+bool groove_ring_pop(struct GrooveRing *ring, void **obj_ptr) {
+    long tail = GROOVE_ATOMIC_LOAD_RELAXED(ring->tail);
+    if (tail == GROOVE_ATOMIC_LOAD(ring->head))
+        return false;
+    *obj_ptr = ring->objs[tail % ring->capacity];
+    // hands the slot back to the producer
+    GROOVE_ATOMIC_STORE(ring->tail, tail + 1);
+    return true;
+}
+
+int groove_ring_count(struct GrooveRing *ring) {
+    long tail = GROOVE_ATOMIC_LOAD(ring->tail);
+    return GROOVE_ATOMIC_LOAD(ring->head) - tail;
+}
+
+int groove_ring_capacity(struct GrooveRing *ring) {
+    return ring->capacity;
+}
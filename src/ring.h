@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2015 Andrew Kelley
+ *
+ * This file is part of libgroove, which is MIT licensed.
+ * See http://opensource.org/licenses/MIT
+ */
+
+#ifndef GROOVE_RING_H
+#define GROOVE_RING_H
+
+#include <stdbool.h>
+
+// A fixed capacity queue of pointers for exactly one producer thread and one
+// consumer thread. Neither side ever locks, allocates or waits, so it is safe
+// to use from a realtime audio callback. NULL may be pushed like any other
+// pointer.
+
+struct GrooveRing;
+
+struct GrooveRing *groove_ring_create(int capacity);
+void groove_ring_destroy(struct GrooveRing *ring);
+
+// producer only. returns false if the ring is full.
+bool groove_ring_push(struct GrooveRing *ring, void *obj);
+
+// consumer only. returns false if the ring is empty.
+bool groove_ring_pop(struct GrooveRing *ring, void **obj_ptr);
+
+// the other side may be running concurrently, so from the producer this can
+// only be too high, and from the consumer only too low
+int groove_ring_count(struct GrooveRing *ring);
+
+int groove_ring_capacity(struct GrooveRing *ring);
+
+#endif
@@ -0,0 +1,341 @@
+/*
+ * Copyright (c) 2015 Andrew Kelley
+ *
+ * This file is part of libgroove, which is MIT licensed.
+ * See http://opensource.org/licenses/MIT
+ */
+
+#include "trace.h"
+#include "os.h"
+#include "util.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+struct TraceEvent {
+    double time; // in seconds, from groove_os_get_time
+    const char *name;
+    char phase;
+};
+
+// each thread records into its own ring, so recording takes no locks. the
+// rings live in a global list which is protected by registry_mutex. the
+// audio callback records events too, so nothing on the recording path may
+// block or allocate: groove_trace_start and groove_trace_thread_name do that
+// work, and the recording thread only picks up what they prepared.
+struct TraceRing {
+    struct TraceRing *next;
+    int tid;
+    const char *thread_name;
+    // set once the owning thread has exited so that a new thread can take
+    // the ring over instead of allocating another one
+    bool owner_exited;
+    // the trace this ring was last reset for. compared against
+    // trace_generation by the owner without the lock, but only written with
+    // registry_mutex held.
+    long generation;
+    // number of events recorded since the ring was reset. only the owner
+    // writes it; groove_trace_dump reads it.
+    struct GrooveAtomicLong head;
+    int capacity;
+    struct TraceEvent *events;
+    // set up by groove_trace_start for the owner to switch to, since the
+    // owner may be recording into events meanwhile. pending_events is NULL
+    // if the capacity did not change. retired_events is what the owner
+    // switched away from, for groove_trace_start to free.
+    long pending_generation;
+    int pending_capacity;
+    struct TraceEvent *pending_events;
+    struct TraceEvent *retired_events;
+};
+
+struct GrooveAtomicBool groove_trace_enabled;
+
+static pthread_mutex_t registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t ring_key;
+static bool ring_key_ok;
+
+// once this many rings exist, new threads take over the rings of exited
+// threads even if that loses events from the current trace
+#define MAX_RINGS 64
+
+// these are protected by registry_mutex
+static struct TraceRing *ring_list;
+static int ring_count;
+static int next_tid = 1;
+static int trace_capacity;
+// incremented by each groove_trace_start, with registry_mutex held
+static struct GrooveAtomicLong trace_generation;
+
+static _Thread_local struct TraceRing *thread_ring;
+static _Thread_local const char *thread_name;
+
+static void release_ring(void *arg) {
+    struct TraceRing *ring = (struct TraceRing *)arg;
+    pthread_mutex_lock(&registry_mutex);
+    ring->owner_exited = true;
+    pthread_mutex_unlock(&registry_mutex);
+}
+
+static void create_ring_key(void) {
+    ring_key_ok = (pthread_key_create(&ring_key, release_ring) == 0);
+}
+
+// must be called with registry_mutex held, by the owner of the ring or while
+// it has none. resets the ring for the current trace, resizing it if the
+// requested capacity changed.
+static bool reset_ring(struct TraceRing *ring) {
+    DEALLOCATE(ring->retired_events);
+    ring->retired_events = NULL;
+    if (ring->capacity != trace_capacity) {
+        struct TraceEvent *events = ring->pending_events;
+        if (!events || ring->pending_capacity != trace_capacity) {
+            DEALLOCATE(events);
+            events = ALLOCATE_NONZERO(struct TraceEvent, trace_capacity);
+        }
+        ring->pending_events = NULL;
+        if (!events)
+            return false;
+        DEALLOCATE(ring->events);
+        ring->events = events;
+        ring->capacity = trace_capacity;
+    }
+    GROOVE_ATOMIC_STORE(ring->head, 0);
+    ring->generation = GROOVE_ATOMIC_LOAD(trace_generation);
+    return true;
+}
+
+// must be called with registry_mutex held. gets the ring of a running thread
+// ready for the owner to switch to the current trace, without touching
+// anything the owner may be using.
+static void prepare_ring(struct TraceRing *ring) {
+    DEALLOCATE(ring->retired_events);
+    ring->retired_events = NULL;
+    if (ring->capacity == trace_capacity) {
+        DEALLOCATE(ring->pending_events);
+        ring->pending_events = NULL;
+    } else if (!ring->pending_events || ring->pending_capacity != trace_capacity) {
+        DEALLOCATE(ring->pending_events);
+        ring->pending_events = ALLOCATE_NONZERO(struct TraceEvent, trace_capacity);
+        if (!ring->pending_events)
+            return;
+        ring->pending_capacity = trace_capacity;
+    }
+    ring->pending_generation = GROOVE_ATOMIC_LOAD(trace_generation);
+}
+
+// must be called by the owner with registry_mutex held. switches to what
+// groove_trace_start prepared, without allocating or freeing.
+static void take_pending(struct TraceRing *ring) {
+    if (ring->pending_generation != GROOVE_ATOMIC_LOAD(trace_generation))
+        return;
+    if (ring->pending_events) {
+        ring->retired_events = ring->events;
+        ring->events = ring->pending_events;
+        ring->capacity = ring->pending_capacity;
+        ring->pending_events = NULL;
+    }
+    GROOVE_ATOMIC_STORE(ring->head, 0);
+    ring->generation = ring->pending_generation;
+}
+
+// must be called with registry_mutex held. gives the calling thread a ring,
+// ready for the current trace if one has been started.
+static struct TraceRing *create_ring(void) {
+    pthread_once(&key_once, create_ring_key);
+
+    // keep the events of exited threads for the current trace unless there
+    // are too many rings already
+    long generation = GROOVE_ATOMIC_LOAD(trace_generation);
+    struct TraceRing *ring = NULL;
+    for (struct TraceRing *it = ring_list; it; it = it->next) {
+        if (!it->owner_exited)
+            continue;
+        if (it->generation != generation || ring_count >= MAX_RINGS) {
+            ring = it;
+            break;
+        }
+    }
+    if (ring) {
+        ring->owner_exited = false;
+    } else {
+        ring = ALLOCATE(struct TraceRing, 1);
+        if (!ring)
+            return NULL;
+        ring->next = ring_list;
+        ring_list = ring;
+        ring_count += 1;
+    }
+    ring->tid = next_tid++;
+    ring->thread_name = thread_name;
+    ring->generation = -1;
+    if (trace_capacity > 0)
+        reset_ring(ring);
+
+    thread_ring = ring;
+    if (ring_key_ok)
+        pthread_setspecific(ring_key, ring);
+    return ring;
+}
+
+// returns the calling thread's ring, ready for the current trace, or NULL if
+// the event has to be dropped
+static struct TraceRing *get_ring(void) {
+    struct TraceRing *ring = thread_ring;
+    long generation = GROOVE_ATOMIC_LOAD_RELAXED(trace_generation);
+    if (ring && ring->generation == generation)
+        return ring;
+
+    // never wait here. threads which have not named themselves get a ring
+    // now, which allocates, but the audio callback always has one by then.
+    if (pthread_mutex_trylock(&registry_mutex) != 0)
+        return NULL;
+    if (ring)
+        take_pending(ring);
+    else
+        ring = create_ring();
+    pthread_mutex_unlock(&registry_mutex);
+
+    return (ring && ring->generation == generation) ? ring : NULL;
+}
+
+void groove_trace_event(const char *name, char phase) {
+    struct TraceRing *ring = get_ring();
+    if (!ring)
+        return;
+
+    long head = GROOVE_ATOMIC_LOAD(ring->head);
+    struct TraceEvent *event = &ring->events[head % ring->capacity];
+    event->time = groove_os_get_time();
+    event->name = name;
+    event->phase = phase;
+    GROOVE_ATOMIC_STORE(ring->head, head + 1);
+}
+
+void groove_trace_thread_name(const char *name) {
+    // the audio callback names its thread on every call, so this must not
+    // touch the registry unless the name changed
+    if (name == thread_name)
+        return;
+    thread_name = name;
+    pthread_mutex_lock(&registry_mutex);
+    if (thread_ring)
+        thread_ring->thread_name = name;
+    else
+        create_ring();
+    pthread_mutex_unlock(&registry_mutex);
+}
+
+int groove_trace_start(int events_per_thread) {
+    if (events_per_thread <= 0)
+        return GrooveErrorInvalid;
+
+    pthread_mutex_lock(&registry_mutex);
+    trace_capacity = events_per_thread;
+    GROOVE_ATOMIC_FETCH_ADD(trace_generation, 1);
+    for (struct TraceRing *ring = ring_list; ring; ring = ring->next) {
+        if (ring->owner_exited)
+            reset_ring(ring);
+        else
+            prepare_ring(ring);
+    }
+    pthread_mutex_unlock(&registry_mutex);
+
+    GROOVE_ATOMIC_STORE(groove_trace_enabled, true);
+    return 0;
+}
+
+void groove_trace_stop(void) {
+    GROOVE_ATOMIC_STORE(groove_trace_enabled, false);
+}
+
+// what groove_trace_dump copies out of one ring
+struct TraceSnapshot {
+    int tid;
+    const char *thread_name;
+    long event_count;
+    struct TraceEvent *events;
+};
+
+// copies every ring of the current trace. must be called with
+// registry_mutex held.
+static int snapshot_rings(struct TraceSnapshot **out, int *out_count) {
+    *out = NULL;
+    *out_count = 0;
+    struct TraceSnapshot *snapshots = ALLOCATE(struct TraceSnapshot, ring_count);
+    if (!snapshots && ring_count > 0)
+        return GrooveErrorNoMem;
+
+    int count = 0;
+    for (struct TraceRing *ring = ring_list; ring; ring = ring->next) {
+        if (ring->generation != GROOVE_ATOMIC_LOAD(trace_generation))
+            continue;
+
+        // the owner may still be recording. copy what is there, then throw
+        // away anything it could have overwritten while we were copying.
+        long end = GROOVE_ATOMIC_LOAD(ring->head);
+        long start = groove_max_long(end - ring->capacity, 0);
+        struct TraceEvent *copy = ALLOCATE_NONZERO(struct TraceEvent, ring->capacity);
+        if (!copy) {
+            *out = snapshots;
+            *out_count = count;
+            return GrooveErrorNoMem;
+        }
+        for (long i = start; i < end; i += 1)
+            copy[i - start] = ring->events[i % ring->capacity];
+        long overwritten = GROOVE_ATOMIC_LOAD(ring->head) - ring->capacity;
+        long first_valid = groove_max_long(start, overwritten);
+        long dropped = first_valid - start;
+        if (dropped > 0)
+            memmove(copy, copy + dropped, (end - first_valid) * sizeof(struct TraceEvent));
+
+        struct TraceSnapshot *snapshot = &snapshots[count++];
+        snapshot->tid = ring->tid;
+        snapshot->thread_name = ring->thread_name;
+        snapshot->event_count = end - first_valid;
+        snapshot->events = copy;
+    }
+    *out = snapshots;
+    *out_count = count;
+    return 0;
+}
+
+int groove_trace_dump(const char *filename) {
+    // copy the rings and write the file after letting go of the lock, so
+    // that no recording thread ever waits on file I/O
+    struct TraceSnapshot *snapshots;
+    int snapshot_count;
+    pthread_mutex_lock(&registry_mutex);
+    int err = snapshot_rings(&snapshots, &snapshot_count);
+    pthread_mutex_unlock(&registry_mutex);
+
+    FILE *f = err ? NULL : fopen(filename, "w");
+    if (!f && !err)
+        err = GrooveErrorFileSystem;
+
+    if (f) {
+        fprintf(f, "{\"traceEvents\":[");
+        for (int i = 0; i < snapshot_count; i += 1) {
+            struct TraceSnapshot *snapshot = &snapshots[i];
+            fprintf(f, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                    "\"args\":{\"name\":\"%s\"}}", (i == 0) ? "" : ",", snapshot->tid,
+                    snapshot->thread_name ? snapshot->thread_name : "unknown");
+            for (long j = 0; j < snapshot->event_count; j += 1) {
+                struct TraceEvent *event = &snapshot->events[j];
+                fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":1,\"tid\":%d%s}",
+                        event->name, event->phase, event->time * 1000000.0, snapshot->tid,
+                        (event->phase == 'i') ? ",\"s\":\"t\"" : "");
+            }
+        }
+        fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+        if (fclose(f) != 0)
+            err = GrooveErrorFileSystem;
+    }
+
+    for (int i = 0; i < snapshot_count; i += 1)
+        DEALLOCATE(snapshots[i].events);
+    DEALLOCATE(snapshots);
+    return err;
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2015 Andrew Kelley
+ *
+ * This file is part of libgroove, which is MIT licensed.
+ * See http://opensource.org/licenses/MIT
+ */
+
+#ifndef GROOVE_TRACE_H
+#define GROOVE_TRACE_H
+
+#include "atomics.h"
+
+// set by groove_trace_start and cleared by groove_trace_stop. checked
+// before doing any other tracing work so that tracing costs one relaxed
+// load when it is off.
+extern struct GrooveAtomicBool groove_trace_enabled;
+
+// records an event in the calling thread's ring. name must be a string
+// literal or otherwise outlive the trace. phase is a Chrome trace event
+// phase: 'B' to begin a span, 'E' to end it, 'i' for an instant.
+void groove_trace_event(const char *name, char phase);
+
+// names the calling thread in dumped traces. name must be a string literal.
+// cheap enough to call whether or not tracing is on, and only locks when the
+// name changes. this is also where a thread's ring is allocated, so that
+// recording events never has to wait or allocate afterwards; a realtime
+// thread must call it before recording anything.
+void groove_trace_thread_name(const char *name);
+
+#define GROOVE_TRACE_BEGIN(name) do { \
+    if (GROOVE_ATOMIC_LOAD_RELAXED(groove_trace_enabled)) \
+        groove_trace_event(name, 'B'); \
+} while (0)
+
+#define GROOVE_TRACE_END(name) do { \
+    if (GROOVE_ATOMIC_LOAD_RELAXED(groove_trace_enabled)) \
+        groove_trace_event(name, 'E'); \
+} while (0)
+
+#define GROOVE_TRACE_INSTANT(name) do { \
+    if (GROOVE_ATOMIC_LOAD_RELAXED(groove_trace_enabled)) \
+        groove_trace_event(name, 'i'); \
+} while (0)
+
+#endif
@@ -48,6 +48,10 @@ static inline float groove_max_float(float a, float b) {
     return (a >= b) ? a : b;
 }
 
+static inline long groove_min_long(long a, long b) {
+    return (a <= b) ? a : b;
+}
+
 static inline long groove_max_long(long a, long b) {
     return (a >= b) ? a : b;
 }
@@ -56,6 +60,10 @@ static inline double groove_max_double(double a, double b) {
     return (a >= b) ? a : b;
 }
 
+static inline double groove_min_double(double a, double b) {
+    return (a <= b) ? a : b;
+}
+
 
 enum SoundIoChannelId from_ffmpeg_channel_id(uint64_t ffmpeg_channel_id);
 void from_ffmpeg_layout(uint64_t in_layout, struct SoundIoChannelLayout *out_layout);
@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2015 Andrew Kelley
+ *
+ * This file is part of libgroove, which is MIT licensed.
+ * See http://opensource.org/licenses/MIT
+ */
+
+#include "virtual_device.h"
+#include "os.h"
+#include "util.h"
+
+#include <math.h>
+
+// fraction of the buffer played on each tick of the timer
+#define PERIODS_PER_BUFFER 2
+
+struct GrooveVirtualOutStream {
+    struct SoundIoOutStream pub;
+
+    double speed;
+    struct GrooveVirtualDeviceCounters *counters;
+
+    // set by open
+    int buffer_frames;
+    int period_frames;
+    // frames played per second of wall clock time
+    double frames_per_second;
+    // the write callback writes here and the audio goes nowhere
+    char *scratch;
+    struct SoundIoChannelArea areas[SOUNDIO_MAX_CHANNELS];
+
+    // this mutex applies to the variables in this block. the timer thread
+    // holds it except while it sleeps, so the write callback runs with it.
+    struct GrooveOsMutex *mutex;
+    struct GrooveOsCond *cond;
+    struct GrooveOsThread *thread;
+    bool abort_request;
+    bool paused;
+    int fill_frames;
+    int write_frames;
+    // when the device clock last (re)started, and the periods played since
+    double clock_start;
+    long clock_periods;
+};
+
+void groove_virtual_device_counters_reset(struct GrooveVirtualDeviceCounters *c) {
+    GROOVE_ATOMIC_STORE(c->callback_count, 0);
+    GROOVE_ATOMIC_STORE(c->callback_ns, 0);
+    GROOVE_ATOMIC_STORE(c->callback_max_ns, 0);
+    GROOVE_ATOMIC_STORE(c->lateness_ns, 0);
+    GROOVE_ATOMIC_STORE(c->lateness_max_ns, 0);
+    GROOVE_ATOMIC_STORE(c->underrun_count, 0);
+    GROOVE_ATOMIC_STORE(c->frames_played, 0);
+    GROOVE_ATOMIC_STORE(c->drift_ns, 0);
+}
+
+// the timer thread is the only writer, so there is no race between the
+// load and the store
+static void record_ns(struct GrooveAtomicLongLong *total, struct GrooveAtomicLongLong *max,
+        double seconds)
+{
+    long long ns = (long long)(seconds * 1000000000.0);
+    GROOVE_ATOMIC_FETCH_ADD_RELAXED((*total), ns);
+    if (ns > GROOVE_ATOMIC_LOAD_RELAXED((*max)))
+        GROOVE_ATOMIC_STORE_RELAXED((*max), ns);
+}
+
+static void restart_clock(struct GrooveVirtualOutStream *v) {
+    v->clock_start = groove_os_get_time();
+    v->clock_periods = 0;
+}
+
+static void call_write_callback(struct GrooveVirtualOutStream *v) {
+    struct SoundIoOutStream *outstream = &v->pub;
+    int frame_count_max = v->buffer_frames - v->fill_frames;
+    if (frame_count_max <= 0)
+        return;
+    int frame_count_min = groove_max_int(v->period_frames - v->fill_frames, 0);
+
+    double start = groove_os_get_time();
+    outstream->write_callback(outstream, frame_count_min, frame_count_max);
+    double end = groove_os_get_time();
+
+    struct GrooveVirtualDeviceCounters *c = v->counters;
+    GROOVE_ATOMIC_FETCH_ADD_RELAXED(c->callback_count, 1);
+    record_ns(&c->callback_ns, &c->callback_max_ns, end - start);
+}
+
+// plays every period which has come due by now. a period the write
+// callback did not fill in time is played anyway, as a sound card would.
+static void play_due_periods(struct GrooveVirtualOutStream *v, double now) {
+    struct GrooveVirtualDeviceCounters *c = v->counters;
+    double period_seconds = v->period_frames / v->frames_per_second;
+    double due_time = v->clock_start + (v->clock_periods + 1) * period_seconds;
+    long periods = (long)floor((now - v->clock_start) / period_seconds) - v->clock_periods;
+    long frames = periods * (long)v->period_frames;
+
+    record_ns(&c->lateness_ns, &c->lateness_max_ns, now - due_time);
+
+    if (frames > v->fill_frames) {
+        v->fill_frames = 0;
+        GROOVE_ATOMIC_FETCH_ADD_RELAXED(c->underrun_count, 1);
+        if (v->pub.underflow_callback)
+            v->pub.underflow_callback(&v->pub);
+    } else {
+        v->fill_frames -= frames;
+    }
+
+    v->clock_periods += periods;
+    GROOVE_ATOMIC_FETCH_ADD_RELAXED(c->frames_played, frames);
+}
+
+static void timer_thread_run(void *arg) {
+    struct GrooveVirtualOutStream *v = (struct GrooveVirtualOutStream *)arg;
+
+    groove_os_mutex_lock(v->mutex);
+    // like a sound card, fill the whole buffer before playing any of it
+    restart_clock(v);
+    call_write_callback(v);
+    while (!v->abort_request) {
+        if (v->paused) {
+            groove_os_cond_wait(v->cond, v->mutex);
+            continue;
+        }
+        double now = groove_os_get_time();
+        double due_time = v->clock_start +
+            (v->clock_periods + 1) * v->period_frames / v->frames_per_second;
+        if (now < due_time) {
+            groove_os_cond_timed_wait(v->cond, v->mutex, due_time - now);
+            continue;
+        }
+        play_due_periods(v, now);
+        call_write_callback(v);
+    }
+    groove_os_mutex_unlock(v->mutex);
+}
+
+struct SoundIoOutStream *groove_virtual_outstream_create(double speed,
+        struct GrooveVirtualDeviceCounters *counters)
+{
+    struct GrooveVirtualOutStream *v = ALLOCATE(struct GrooveVirtualOutStream, 1);
+    if (!v)
+        return NULL;
+
+    v->speed = speed;
+    v->counters = counters;
+    v->pub.software_latency = 0.025;
+
+    if (!(v->mutex = groove_os_mutex_create())) {
+        groove_virtual_outstream_destroy(&v->pub);
+        return NULL;
+    }
+    if (!(v->cond = groove_os_cond_create())) {
+        groove_virtual_outstream_destroy(&v->pub);
+        return NULL;
+    }
+
+    return &v->pub;
+}
+
+void groove_virtual_outstream_destroy(struct SoundIoOutStream *outstream) {
+    if (!outstream)
+        return;
+
+    struct GrooveVirtualOutStream *v = (struct GrooveVirtualOutStream *)outstream;
+
+    if (v->thread) {
+        groove_os_mutex_lock(v->mutex);
+        v->abort_request = true;
+        groove_os_cond_signal(v->cond, v->mutex);
+        groove_os_mutex_unlock(v->mutex);
+        groove_os_thread_destroy(v->thread);
+    }
+
+    groove_os_cond_destroy(v->cond);
+    groove_os_mutex_destroy(v->mutex);
+    DEALLOCATE(v->scratch);
+    DEALLOCATE(v);
+}
+
+int groove_virtual_outstream_open(struct SoundIoOutStream *outstream) {
+    struct GrooveVirtualOutStream *v = (struct GrooveVirtualOutStream *)outstream;
+
+    int channel_count = outstream->layout.channel_count;
+    if (channel_count <= 0 || channel_count > SOUNDIO_MAX_CHANNELS)
+        return SoundIoErrorInvalid;
+    if (outstream->sample_rate <= 0 || !(outstream->software_latency > 0.0))
+        return SoundIoErrorInvalid;
+    if (!(v->speed > 0.0))
+        return SoundIoErrorInvalid;
+
+    outstream->bytes_per_sample = soundio_get_bytes_per_sample(outstream->format);
+    if (outstream->bytes_per_sample <= 0)
+        return SoundIoErrorInvalid;
+    outstream->bytes_per_frame = outstream->bytes_per_sample * channel_count;
+
+    v->buffer_frames = groove_max_int(ceil(outstream->software_latency * outstream->sample_rate),
+            PERIODS_PER_BUFFER);
+    v->period_frames = v->buffer_frames / PERIODS_PER_BUFFER;
+    v->frames_per_second = outstream->sample_rate * v->speed;
+
+    v->scratch = ALLOCATE_NONZERO(char, v->buffer_frames * outstream->bytes_per_frame);
+    if (!v->scratch)
+        return SoundIoErrorNoMem;
+
+    return 0;
+}
+
+int groove_virtual_outstream_start(struct SoundIoOutStream *outstream) {
+    struct GrooveVirtualOutStream *v = (struct GrooveVirtualOutStream *)outstream;
+    int err;
+    if (v->thread)
+        return SoundIoErrorInvalid;
+    if ((err = groove_os_thread_create(timer_thread_run, v, &v->thread)))
+        return SoundIoErrorSystemResources;
+    return 0;
+}
+
+int groove_virtual_outstream_pause(struct SoundIoOutStream *outstream, bool pause) {
+    struct GrooveVirtualOutStream *v = (struct GrooveVirtualOutStream *)outstream;
+    groove_os_mutex_lock(v->mutex);
+    // the clock does not run while paused
+    if (v->paused && !pause)
+        restart_clock(v);
+    v->paused = pause;
+    groove_os_cond_signal(v->cond, v->mutex);
+    groove_os_mutex_unlock(v->mutex);
+    return 0;
+}
+
+int groove_virtual_outstream_clear_buffer(struct SoundIoOutStream *outstream) {
+    struct GrooveVirtualOutStream *v = (struct GrooveVirtualOutStream *)outstream;
+    groove_os_mutex_lock(v->mutex);
+    v->fill_frames = 0;
+    groove_os_mutex_unlock(v->mutex);
+    return 0;
+}
+
+int groove_virtual_outstream_get_latency(struct SoundIoOutStream *outstream,
+        double *out_latency)
+{
+    struct GrooveVirtualOutStream *v = (struct GrooveVirtualOutStream *)outstream;
+    // in seconds of audio, like the play position it adjusts. it takes
+    // fill_frames / frames_per_second of wall clock time to play.
+    *out_latency = v->fill_frames / (double)outstream->sample_rate;
+    return 0;
+}
+
+int groove_virtual_outstream_begin_write(struct SoundIoOutStream *outstream,
+        struct SoundIoChannelArea **areas, int *frame_count)
+{
+    struct GrooveVirtualOutStream *v = (struct GrooveVirtualOutStream *)outstream;
+    int free_frames = v->buffer_frames - v->fill_frames;
+    if (*frame_count <= 0 || free_frames <= 0)
+        return SoundIoErrorInvalid;
+    v->write_frames = groove_min_int(*frame_count, free_frames);
+    *frame_count = v->write_frames;
+    // the caller is allowed to move these along as it writes
+    for (int ch = 0; ch < outstream->layout.channel_count; ch += 1) {
+        v->areas[ch].ptr = v->scratch + ch * outstream->bytes_per_sample;
+        v->areas[ch].step = outstream->bytes_per_frame;
+    }
+    *areas = v->areas;
+    return 0;
+}
+
+int groove_virtual_outstream_end_write(struct SoundIoOutStream *outstream) {
+    struct GrooveVirtualOutStream *v = (struct GrooveVirtualOutStream *)outstream;
+    v->fill_frames += v->write_frames;
+    v->write_frames = 0;
+    return 0;
+}
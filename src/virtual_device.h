@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2015 Andrew Kelley
+ *
+ * This file is part of libgroove, which is MIT licensed.
+ * See http://opensource.org/licenses/MIT
+ */
+
+#ifndef GROOVE_VIRTUAL_DEVICE_H
+#define GROOVE_VIRTUAL_DEVICE_H
+
+#include "atomics.h"
+
+#include <soundio/soundio.h>
+
+// An output stream with no sound card behind it. A timer thread plays one
+// period of the buffer at a time, on schedule, and calls the stream's
+// callbacks the way libsoundio would. The functions mirror the
+// soundio_outstream_* functions of the same name.
+
+// written by the timer thread, readable from any thread. a player hands the
+// same counters to every outstream it opens, so they add up across device
+// re-opens.
+struct GrooveVirtualDeviceCounters {
+    struct GrooveAtomicLongLong callback_count;
+    struct GrooveAtomicLongLong callback_ns;
+    struct GrooveAtomicLongLong callback_max_ns;
+    // how long after its scheduled time each period was played
+    struct GrooveAtomicLongLong lateness_ns;
+    struct GrooveAtomicLongLong lateness_max_ns;
+    struct GrooveAtomicLongLong underrun_count;
+    struct GrooveAtomicLongLong frames_played;
+    // not touched by the outstream. the player's write callback, which runs
+    // on the timer thread, measures it; see GrooveVirtualDeviceStats.
+    struct GrooveAtomicLongLong drift_ns;
+};
+
+void groove_virtual_device_counters_reset(struct GrooveVirtualDeviceCounters *counters);
+
+// speed is the number of seconds of audio played per second of wall clock
+// time, and must be > 0. counters must outlive the outstream.
+struct SoundIoOutStream *groove_virtual_outstream_create(double speed,
+        struct GrooveVirtualDeviceCounters *counters);
+void groove_virtual_outstream_destroy(struct SoundIoOutStream *outstream);
+
+int groove_virtual_outstream_open(struct SoundIoOutStream *outstream);
+int groove_virtual_outstream_start(struct SoundIoOutStream *outstream);
+int groove_virtual_outstream_pause(struct SoundIoOutStream *outstream, bool pause);
+int groove_virtual_outstream_clear_buffer(struct SoundIoOutStream *outstream);
+
+// write_callback only
+int groove_virtual_outstream_get_latency(struct SoundIoOutStream *outstream,
+        double *out_latency);
+int groove_virtual_outstream_begin_write(struct SoundIoOutStream *outstream,
+        struct SoundIoChannelArea **areas, int *frame_count);
+int groove_virtual_outstream_end_write(struct SoundIoOutStream *outstream);
+
+#endif
@@ -9,6 +9,7 @@
 #include "groove/waveform.h"
 #include "util.h"
 #include "queue.h"
+#include "trace.h"
 
 #include <pthread.h>
 
@@ -45,9 +46,6 @@ struct GrooveWaveformPrivate {
     pthread_cond_t drain_cond;
     bool drain_cond_inited;
 
-    // set temporarily
-    struct GroovePlaylistItem *purge_item;
-
     int abort_request;
 };
 
@@ -104,6 +102,8 @@ static void *waveform_thread(void *arg) {
 
     struct GrooveBuffer *buffer;
 
+    groove_trace_thread_name("waveform");
+
     pthread_mutex_lock(&w->info_head_mutex);
     while (!w->abort_request) {
         if (w->info_queue_bytes >= waveform->info_queue_size_bytes) {
@@ -121,7 +121,9 @@ static void *waveform_thread(void *arg) {
         pthread_mutex_lock(&w->info_head_mutex);
 
         if (result == GROOVE_BUFFER_END) {
+            GROOVE_TRACE_BEGIN("emit_track_info");
             emit_track_info(w);
+            GROOVE_TRACE_END("emit_track_info");
 
             int err;
             if ((err = groove_queue_put(w->info_queue, create_info(w, NULL))))
@@ -137,7 +139,9 @@ static void *waveform_thread(void *arg) {
         }
 
         if (buffer->item != w->info_head) {
+            GROOVE_TRACE_BEGIN("emit_track_info");
             emit_track_info(w);
+            GROOVE_TRACE_END("emit_track_info");
 
             if (buffer->item) {
                 // start a track
@@ -216,20 +220,16 @@ static void info_queue_get(struct GrooveQueue *queue, void *obj) {
         pthread_cond_signal(&w->drain_cond);
 }
 
-static int info_queue_purge(struct GrooveQueue* queue, void *obj) {
+static void *info_queue_group(struct GrooveQueue* queue, void *obj) {
     struct GrooveWaveformInfo *info = (struct GrooveWaveformInfo *)obj;
-    struct GrooveWaveformPrivate *w = (struct GrooveWaveformPrivate *)queue->context;
-
-    return info->item == w->purge_item;
+    return info->item;
 }
 
 static void sink_purge(struct GrooveSink *sink, struct GroovePlaylistItem *item) {
     struct GrooveWaveformPrivate *w = (struct GrooveWaveformPrivate *)sink->userdata;
 
     pthread_mutex_lock(&w->info_head_mutex);
-    w->purge_item = item;
-    groove_queue_purge(w->info_queue);
-    w->purge_item = NULL;
+    groove_queue_purge(w->info_queue, item);
 
     if (w->info_head == item) {
         w->info_head = NULL;
@@ -286,7 +286,7 @@ struct GrooveWaveform *groove_waveform_create(struct Groove *groove) {
     w->info_queue->cleanup = info_queue_cleanup;
     w->info_queue->put = info_queue_put;
     w->info_queue->get = info_queue_get;
-    w->info_queue->purge = info_queue_purge;
+    w->info_queue->group = info_queue_group;
 
     w->sink = groove_sink_create(groove);
     if (!w->sink) {
@@ -386,16 +386,32 @@ int groove_waveform_detach(struct GrooveWaveform *waveform) {
 
 int groove_waveform_info_get(struct GrooveWaveform *waveform,
         struct GrooveWaveformInfo **info, int block)
+{
+    return groove_waveform_info_get_timeout(waveform, info, block ? -1.0 : 0.0);
+}
+
+int groove_waveform_info_get_timeout(struct GrooveWaveform *waveform,
+        struct GrooveWaveformInfo **info, double seconds)
 {
     struct GrooveWaveformPrivate *w = (struct GrooveWaveformPrivate *) waveform;
 
-    if (groove_queue_get(w->info_queue, (void**)info, block) == 1) {
+    if (groove_queue_get_timeout(w->info_queue, (void**)info, seconds) == 1) {
         return 1;
     }
 
     return 0;
 }
 
+int groove_waveform_get_fd(struct GrooveWaveform *waveform) {
+    struct GrooveWaveformPrivate *w = (struct GrooveWaveformPrivate *) waveform;
+    return groove_queue_get_fd(w->info_queue);
+}
+
+void groove_waveform_get_stats(struct GrooveWaveform *waveform, struct GrooveSinkStats *stats) {
+    struct GrooveWaveformPrivate *w = (struct GrooveWaveformPrivate *) waveform;
+    groove_sink_get_stats(w->sink, stats);
+}
+
 int groove_waveform_info_peek(struct GrooveWaveform *waveform, int block) {
     struct GrooveWaveformPrivate *w = (struct GrooveWaveformPrivate *) waveform;
     return groove_queue_peek(w->info_queue, block);